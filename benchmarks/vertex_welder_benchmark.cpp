@@ -0,0 +1,258 @@
+/**
+ * Micro-benchmark comparing the std::unordered_map based vertex deduplication
+ * that loadModel() used to do against VertexWelder.
+ *
+ * Usage: VertexWelderBenchmark [model.obj] [synthetic corner count]
+ *
+ * Two inputs are measured:
+ *      The shipped model (corners taken from the OBJ exactly like loadModel()).
+ *      A synthetic grid mesh with the requested number of corners (default 10M),
+ *      where every interior vertex is shared by six corners.
+ */
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../tiny_obj_loader.h"
+
+#include "../vertex_welder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const std::string MODEL_PATH = "/Users/stevencheng/CLionProjects/VulkanTutorial/models/viking_room.obj";
+
+/*
+ * Number of timed repetitions per input, the fastest one is reported
+ */
+const int REPETITIONS = 5;
+
+/**
+ * Same layout as the Vertex struct in main.cpp.
+ */
+struct Vertex
+{
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+
+    bool operator==(const Vertex &other) const
+    {
+        return pos == other.pos && color == other.color && texCoord == other.texCoord;
+    }
+};
+
+/*
+ * The hash loadModel() used with std::unordered_map.
+ */
+namespace std
+{
+    template <>
+    struct hash<Vertex>
+    {
+        size_t operator()(Vertex const &vertex) const
+        {
+            return ((hash<glm::vec3>()(vertex.pos) ^
+                     (hash<glm::vec3>()(vertex.color) << 1)) >>
+                    1) ^
+                   (hash<glm::vec2>()(vertex.texCoord) << 1);
+        }
+    };
+}
+
+/**
+ * Result of deduplicating a corner list.
+ */
+struct WeldResult
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+/**
+ * Deduplication exactly as loadModel() did it before the welder.
+ */
+WeldResult weldWithMap(const std::vector<Vertex> &corners)
+{
+    WeldResult result;
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+    for (const Vertex &vertex : corners)
+    {
+        if (uniqueVertices.count(vertex) == 0)
+        {
+            uniqueVertices[vertex] = static_cast<uint32_t>(result.vertices.size());
+            result.vertices.push_back(vertex);
+        }
+
+        result.indices.push_back(uniqueVertices[vertex]);
+    }
+
+    return result;
+}
+
+/**
+ * Deduplication through VertexWelder, pre-sized like loadModel() does.
+ */
+WeldResult weldWithWelder(const std::vector<Vertex> &corners, size_t expectedVertices)
+{
+    WeldResult result;
+    VertexWelder<Vertex> welder(expectedVertices);
+    result.vertices.reserve(expectedVertices);
+    result.indices.reserve(corners.size());
+
+    for (const Vertex &vertex : corners)
+    {
+        result.indices.push_back(welder.weld(vertex, result.vertices));
+    }
+
+    return result;
+}
+
+/**
+ * Flattens the OBJ into one Vertex per face corner, like loadModel().
+ *
+ * @param path Path of the OBJ file.
+ * @param positionCount Receives the number of OBJ positions.
+ */
+std::vector<Vertex> loadCorners(const std::string &path, size_t &positionCount)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+    {
+        throw std::runtime_error(warn + err);
+    }
+
+    std::vector<Vertex> corners;
+    for (const auto &shape : shapes)
+    {
+        for (const auto &index : shape.mesh.indices)
+        {
+            Vertex vertex{};
+            vertex.pos = {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2]};
+            vertex.texCoord = {
+                attrib.texcoords[2 * index.texcoord_index + 0],
+                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+            vertex.color = {1.0f, 1.0f, 1.0f};
+            corners.push_back(vertex);
+        }
+    }
+
+    positionCount = attrib.vertices.size() / 3;
+    return corners;
+}
+
+/**
+ * Builds a square grid mesh of roughly 'cornerCount' corners (two triangles per cell).
+ *
+ * @param positionCount Receives the number of grid vertices.
+ */
+std::vector<Vertex> makeGridCorners(size_t cornerCount, size_t &positionCount)
+{
+    size_t cells = std::max<size_t>(1, cornerCount / 6);
+    size_t side = 1;
+    while ((side + 1) * (side + 1) <= cells)
+    {
+        side++;
+    }
+
+    auto gridVertex = [side](size_t x, size_t y)
+    {
+        Vertex vertex{};
+        float u = static_cast<float>(x) / static_cast<float>(side);
+        float v = static_cast<float>(y) / static_cast<float>(side);
+        vertex.pos = {u, v, 0.0f};
+        vertex.color = {1.0f, 1.0f, 1.0f};
+        vertex.texCoord = {u, 1.0f - v};
+        return vertex;
+    };
+
+    std::vector<Vertex> corners;
+    corners.reserve(side * side * 6);
+    for (size_t y = 0; y < side; y++)
+    {
+        for (size_t x = 0; x < side; x++)
+        {
+            corners.push_back(gridVertex(x, y));
+            corners.push_back(gridVertex(x + 1, y));
+            corners.push_back(gridVertex(x + 1, y + 1));
+            corners.push_back(gridVertex(x, y));
+            corners.push_back(gridVertex(x + 1, y + 1));
+            corners.push_back(gridVertex(x, y + 1));
+        }
+    }
+
+    positionCount = (side + 1) * (side + 1);
+    return corners;
+}
+
+/**
+ * Times both deduplication strategies on one input and prints the results.
+ */
+void runBenchmark(const std::string &name, const std::vector<Vertex> &corners, size_t expectedVertices)
+{
+    double mapTime = 1e30;
+    double welderTime = 1e30;
+    WeldResult mapResult;
+    WeldResult welderResult;
+
+    for (int i = 0; i < REPETITIONS; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        mapResult = weldWithMap(corners);
+        auto end = std::chrono::high_resolution_clock::now();
+        mapTime = std::min(mapTime, std::chrono::duration<double, std::milli>(end - start).count());
+
+        start = std::chrono::high_resolution_clock::now();
+        welderResult = weldWithWelder(corners, expectedVertices);
+        end = std::chrono::high_resolution_clock::now();
+        welderTime = std::min(welderTime, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    bool identical = mapResult.indices == welderResult.indices &&
+                     mapResult.vertices.size() == welderResult.vertices.size();
+
+    std::cout << name << ": " << corners.size() << " corners, " << welderResult.vertices.size() << " unique vertices" << std::endl;
+    std::cout << "    unordered_map: " << mapTime << " ms" << std::endl;
+    std::cout << "    VertexWelder:  " << welderTime << " ms (" << mapTime / welderTime << "x)" << std::endl;
+    std::cout << "    output " << (identical ? "identical" : "DIFFERS") << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::string modelPath = argc > 1 ? argv[1] : MODEL_PATH;
+    size_t syntheticCorners = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+
+    try
+    {
+        size_t positionCount = 0;
+        std::vector<Vertex> corners = loadCorners(modelPath, positionCount);
+        runBenchmark(modelPath, corners, positionCount);
+
+        corners = makeGridCorners(syntheticCorners, positionCount);
+        runBenchmark("synthetic grid", corners, positionCount);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/**
+ * Multi-threaded command recording into secondary command buffers.
+ *
+ * A render pass with thousands of draws takes longer to record than the GPU
+ * takes to execute it. A ParallelCommandRecorder splits the draws into one
+ * contiguous range per thread. Every thread records its range into its own
+ * secondary command buffer, which the primary then runs in range order:
+ *
+ *      vkCmdBeginRenderPass(primary, ..., VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+ *      const std::vector<VkCommandBuffer> &secondaries = recorder.record(frame, inheritance, drawCount, recordRange);
+ *      vkCmdExecuteCommands(primary, secondaries.size(), secondaries.data());
+ *      vkCmdEndRenderPass(primary);
+ *
+ * Command pools are externally synchronized, so each thread has one pool per
+ * frame in flight. A pool is reset before its frame slot is recorded again,
+ * which the caller's fence wait for that slot makes safe. The calling thread
+ * records the first range itself. Worker threads live as long as the
+ * recorder, because starting threads every frame would cost more than the
+ * recording they save.
+ *
+ * Secondary command buffers inherit no dynamic state, so every range has to
+ * bind the pipeline, buffers and descriptor sets and set the viewport and
+ * scissor itself.
+ */
+#ifndef COMMAND_RECORDER_H
+#define COMMAND_RECORDER_H
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+class ParallelCommandRecorder
+{
+public:
+    /**
+     * Records the items [first, last) into 'commandBuffer', which is already
+     * begun. 'thread' is the index of the recording thread, for per-thread
+     * state such as counters. Called on several threads at once.
+     */
+    typedef std::function<void(VkCommandBuffer commandBuffer, unsigned thread, size_t first, size_t last)> RecordRange;
+
+    /**
+     * @param device Logical device.
+     * @param queueFamily Queue family the primary command buffers are submitted to.
+     * @param threadCount Recording threads including the caller, 0 = one per hardware thread.
+     * @param frameCount Number of frames in flight.
+     */
+    ParallelCommandRecorder(VkDevice device, uint32_t queueFamily, unsigned threadCount, uint32_t frameCount)
+        : device(device), frameCount(frameCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        commandPools.resize(threadCount * frameCount, VK_NULL_HANDLE);
+        commandBuffers.resize(frameCount, std::vector<VkCommandBuffer>(threadCount));
+
+        for (unsigned thread = 0; thread < threadCount; thread++)
+        {
+            for (uint32_t frame = 0; frame < frameCount; frame++)
+            {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex = queueFamily;
+
+                VkCommandPool &pool = commandPools[thread * frameCount + frame];
+                if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+                {
+                    destroyCommandPools();
+                    throw std::runtime_error("failed to create secondary command pool!");
+                }
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = pool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+
+                if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[frame][thread]) != VK_SUCCESS)
+                {
+                    destroyCommandPools();
+                    throw std::runtime_error("failed to allocate secondary command buffers!");
+                }
+            }
+        }
+
+        for (unsigned thread = 1; thread < threadCount; thread++)
+        {
+            threads.emplace_back([this, thread]()
+                                 { workerLoop(thread); });
+        }
+    }
+
+    /**
+     * Joins the workers and destroys the command pools. No command buffer
+     * returned by record() may still be pending.
+     */
+    ~ParallelCommandRecorder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        destroyCommandPools();
+    }
+
+    ParallelCommandRecorder(const ParallelCommandRecorder &) = delete;
+    ParallelCommandRecorder &operator=(const ParallelCommandRecorder &) = delete;
+
+    /**
+     * Records 'itemCount' items into the secondary command buffers of 'frame',
+     * splitting them evenly over the threads. Threads left without items
+     * record an empty command buffer. The first exception thrown by
+     * 'recordRange' is rethrown once all threads are done.
+     *
+     * @param inheritance Render pass, subpass and framebuffer the buffers run in.
+     * @return One command buffer per thread, to be executed in order.
+     */
+    const std::vector<VkCommandBuffer> &record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance,
+                                               size_t itemCount, const RecordRange &recordRange)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = Job{frame, &inheritance, itemCount, &recordRange};
+            error = nullptr;
+            pending = threads.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        recordThread(0);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]()
+                      { return pending == 0; });
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return commandBuffers[frame];
+    }
+
+    unsigned threadCount() const
+    {
+        return static_cast<unsigned>(threads.size() + 1);
+    }
+
+private:
+    struct Job
+    {
+        uint32_t frame;
+        const VkCommandBufferInheritanceInfo *inheritance;
+        size_t itemCount;
+        const RecordRange *recordRange;
+    };
+
+    void workerLoop(unsigned thread)
+    {
+        uint64_t seenGeneration = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seenGeneration]()
+                          { return stopping || generation != seenGeneration; });
+                if (stopping)
+                {
+                    return;
+                }
+                seenGeneration = generation;
+            }
+
+            recordThread(thread);
+
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                last = --pending == 0;
+            }
+            if (last)
+            {
+                done.notify_one();
+            }
+        }
+    }
+
+    /*
+     * Records this thread's share of the current job.
+     */
+    void recordThread(unsigned thread)
+    {
+        size_t count = threadCount();
+        size_t first = job.itemCount * thread / count;
+        size_t last = job.itemCount * (thread + 1) / count;
+        VkCommandBuffer commandBuffer = commandBuffers[job.frame][thread];
+
+        try
+        {
+            vkResetCommandPool(device, commandPools[thread * frameCount + job.frame], 0);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = job.inheritance;
+
+            if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to begin recording secondary command buffer!");
+            }
+
+            if (first < last)
+            {
+                (*job.recordRange)(commandBuffer, thread, first, last);
+            }
+
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    void destroyCommandPools()
+    {
+        /* Destroying a pool frees its command buffers */
+        for (VkCommandPool pool : commandPools)
+        {
+            if (pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
+        }
+        commandPools.clear();
+    }
+
+    VkDevice device;
+    uint32_t frameCount;
+    std::vector<VkCommandPool> commandPools;                  // Indexed by thread * frameCount + frame
+    std::vector<std::vector<VkCommandBuffer>> commandBuffers; // Indexed by [frame][thread]
+
+    std::vector<std::thread> threads; // Threads 1 and up, thread 0 is the caller of record()
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Job job{};
+    uint64_t generation = 0;
+    size_t pending = 0; // Worker threads still recording the current job
+    bool stopping = false;
+    std::exception_ptr error;
+};
+
+#endif // COMMAND_RECORDER_H
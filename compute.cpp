@@ -9,6 +9,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "device_allocator.h"
+#include "frame_profiler.h"
+#include "fixed_timestep.h"
+#include "gpu_timer.h"
+#include "frame_statistics.h"
+#include "startup_profiler.h"
+#include "pipeline_cache.h"
+#include "pipeline_compiler.h"
+#include "shader_library.h"
+
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -19,10 +29,12 @@
 #include <cstdlib>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <array>
 #include <optional>
 #include <set>
-#include <random>
+#include <string>
+#include <ctime>
 
 /*
  * Variables for window dimensions
@@ -31,15 +43,51 @@ const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 /*
- * Number of particles to visualize
+ * Frames rendered by a headless run unless --frames says otherwise
+ */
+const uint32_t HEADLESS_DEFAULT_FRAMES = 100;
+
+/*
+ * Pipeline cache file, relative to the working directory
+ */
+const std::string PIPELINE_CACHE_PATH = "compute_pipeline_cache.bin";
+
+/*
+ * Number of particles to visualize unless --particles says otherwise
  */
 const uint32_t PARTICLE_COUNT = 8192;
 
+/*
+ * Fixed simulation steps per second unless --sim-rate says otherwise
+ */
+const double SIMULATION_RATE = 120.0;
+
+/*
+ * Most simulation steps one frame may catch up on unless --max-substeps says otherwise
+ */
+const uint32_t MAX_SUBSTEPS = 8;
+
+/*
+ * Shader time units per millisecond, the speed the particles were tuned for
+ */
+const float SIMULATION_TIME_SCALE = 2.0f;
+
+/*
+ * local_size_x of comp.comp
+ */
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+
 /*
  * Max frames in buffer
  */
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+/*
+ * GPU query scopes, see --gpu-timestamps and --frame-stats
+ */
+const uint32_t GPU_SCOPE_RENDER_PASS = 0;
+const uint32_t GPU_SCOPE_COMPUTE_DISPATCH = 1;
+
 /*
  * Validation layers used
  */
@@ -107,6 +155,7 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsAndComputeFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> computeFamily;  // Compute family without graphics for the simulation, optional
 
     bool isComplete()
     {
@@ -114,6 +163,25 @@ struct QueueFamilyIndices
     }
 };
 
+/**
+ * Push constants of comp.comp: the particles one dispatch updates.
+ */
+struct DispatchRange
+{
+    uint32_t particleCount; // Invocations at or past it return early
+    uint32_t firstParticle; // Particle of the dispatch's first invocation
+};
+
+/**
+ * Push constants of particleInit.comp past its DispatchRange.
+ */
+struct ParticleInitParameters
+{
+    uint32_t seed;
+    float aspectRatio;    // Height / width of the image, keeps the disc round on screen
+    uint32_t writeColors; // Nonzero for one dispatch only, as all states share the color buffer
+};
+
 /**
  * Struct for querying details for swap chain support. Checks:
  *      Basic surface capabilities (min/max number of images in swap chain, min/max width and height of images)
@@ -132,91 +200,179 @@ struct SwapChainSupportDetails
  */
 struct UniformBufferObject
 {
-    float deltaTime = 1.0f;
+    float deltaTime = 1.0f; // Length of one substep
+    uint32_t substeps = 1;  // Fixed steps comp.comp runs in this batch
 };
 
 /**
- * Struct for storing particle data that will be passed to the compute shader.
+ * Particle data, stored as a structure of arrays. Every attribute has its own
+ * buffer, so the compute shader only streams the state it updates and the
+ * vertex shader only what it draws:
+ *
+ *      positions           vec2, one buffer per state slot, updated by comp.comp
+ *      previous positions  vec2, one buffer per state slot, the positions one
+ *                          step earlier, which the vertex shader interpolates from
+ *      velocities          vec2, one buffer per state slot, updated by comp.comp
+ *      colors              RGBA8, a single buffer written once by particleInit.comp
  */
 struct Particle
 {
-    glm::vec2 position;
-    glm::vec2 velocity;
-    glm::vec4 color;
+    typedef glm::vec2 Position;
+    typedef glm::vec2 Velocity;
+    typedef uint32_t Color; // packUnorm4x8(), red in the lowest byte
 
     /**
-     * Retrieves the vertex input binding description.
+     * Retrieves the vertex input binding descriptions: positions at binding 0,
+     * colors at binding 1 and previous positions at binding 2, each from its
+     * own buffer.
      *
-     * @return VkVertexInputBindingDescription - The vertex input binding description, initialized with default values.
-     * The binding description specifies the binding index, stride, and input rate for vertex data.
+     * @return The binding descriptions, specifying the binding index, stride, and input rate of each buffer.
      */
-    static VkVertexInputBindingDescription getBindingDescription()
+    static std::array<VkVertexInputBindingDescription, 3> getBindingDescriptions()
     {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Particle);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        std::array<VkVertexInputBindingDescription, 3> bindingDescriptions{};
+
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(Position);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = sizeof(Color);
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        bindingDescriptions[2].binding = 2;
+        bindingDescriptions[2].stride = sizeof(Position);
+        bindingDescriptions[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-        return bindingDescription;
+        return bindingDescriptions;
     }
 
     /**
      * This static method returns an array of VkVertexInputAttributeDescription
-     * structures representing the attribute descriptions for the vertex input. The
-     * array contains three elements, each describing a specific vertex attribute.
+     * structures representing the attribute descriptions for the vertex input.
      * The attribute descriptions specify the binding, location, format, and offset
-     * of each attribute in the vertex data.
+     * of each attribute in the vertex data. The color is unpacked to a vec4 by
+     * the vertex fetch.
      *
      * @return std::array<VkVertexInputAttributeDescription, 3> An array of VkVertexInputAttributeDescription structures
      *         representing the attribute descriptions for the vertex input.
      */
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
     {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
 
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
         attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Particle, position);
+        attributeDescriptions[0].offset = 0;
 
-        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].binding = 1;
         attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Particle, color);
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = 0;
+
+        attributeDescriptions[2].binding = 2;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[2].offset = 0;
 
         return attributeDescriptions;
     }
 };
 
+/**
+ * Options that can be set from the command line, see parseOptions().
+ */
+struct ApplicationOptions
+{
+    bool headless = false;  // Render offscreen without GLFW, a surface or a swap chain
+    uint32_t width = WIDTH; // Window or offscreen image size
+    uint32_t height = HEIGHT;
+    uint32_t frames = 0; // Frames to render before exiting, 0 = until the window is closed
+    uint32_t benchmarkFrames = 0;    // Frames to measure after the warm-up, 0 = no benchmark
+    uint32_t warmupFrames = 60;      // Frames to run before measuring
+    std::string benchmarkJson = "benchmark.json"; // Machine-readable benchmark report
+    std::string gpuTimestamps; // CSV file receiving per-frame GPU scope times, empty = no GPU timing
+    std::string frameStatistics; // CSV file receiving per-frame command counts and pipeline statistics, empty = none
+    bool startupReport = false; // Print wall and CPU time per initialization stage
+    std::string startupJson;    // Machine-readable startup report, empty = none
+    bool exitAfterInit = false; // Exit right after initialization, without drawing a frame
+    std::string pipelineCache = PIPELINE_CACHE_PATH; // Pipeline cache file, empty = compile every launch
+    unsigned pipelineThreads = 1; // Background pipeline compile threads, 0 = compile inside initVulkan()
+    uint32_t particleCount = PARTICLE_COUNT; // Particles simulated and drawn
+    std::optional<uint32_t> seed; // Seed of the particle initializer, unset = seeded from the clock
+    uint32_t simulationLead = 1;  // Simulation steps queued ahead of the state being drawn
+    bool asyncCompute = true;     // Simulate on a compute-only queue family if the device has one
+    double simulationRate = SIMULATION_RATE; // Fixed simulation steps per second
+    uint32_t maxSubsteps = MAX_SUBSTEPS;     // Most steps one frame may catch up on, the rest is dropped
+};
+
 /**
  * Main class
  */
 class ComputeShaderApplication
 {
 public:
+    explicit ComputeShaderApplication(const ApplicationOptions &options)
+        : options(options), profiler(options.warmupFrames, options.benchmarkFrames), pipelineCompiler(options.pipelineThreads),
+          simulationClock(1000.0 / options.simulationRate, options.maxSubsteps)
+    {
+    }
+
     /**
      * Runs all Vulkan functions
      */
     void run()
     {
-        initWindow();
+        if (!options.headless)
+        {
+            initWindow();
+            startup.mark("initWindow");
+        }
         initVulkan();
-        mainLoop();
+
+        if (options.exitAfterInit)
+        {
+            /* Particle initialization and pipeline compiles may still be in flight */
+            vkDeviceWaitIdle(device);
+            graphicsPipeline.get();
+            computePipeline.get();
+            particleInitPipeline.get();
+            finishStartup("waitForBackgroundWork");
+        }
+        else
+        {
+            mainLoop();
+        }
         cleanup();
     }
 
 private:
-    GLFWwindow *window;
+    ApplicationOptions options;
+    FrameProfiler profiler; // CPU frame and drawFrame() phase times for --benchmark
+    StartupProfiler startup; // Time per initialization stage, started when the application is constructed
+    std::unique_ptr<PersistentPipelineCache> pipelineCache; // Used for every pipeline creation
+    PipelineCompiler pipelineCompiler; // Compiles pipelines while the rest of initVulkan() runs
+    std::unique_ptr<GpuTimer> gpuTimer; // GPU time per scope, only with --gpu-timestamps
+    std::ofstream gpuTimestampFile;
+    CommandCounters commandCounters; // Commands recorded for the current frame
+    std::unique_ptr<FrameStatistics> frameStatistics; // Per-frame counters, only with --frame-stats
+    std::ofstream frameStatisticsFile;
+    bool pipelineStatisticsEnabled = false; // Device created with the pipelineStatisticsQuery feature
+
+    GLFWwindow *window = nullptr;
 
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
-    VkSurfaceKHR surface; // For showing results to the screen
+    VkSurfaceKHR surface = VK_NULL_HANDLE; // For showing results to the screen, none when headless
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device; // logical device
 
+    QueueFamilyIndices queueFamilies; // Families the logical device was created with
+
     VkQueue graphicsQueue;
-    VkQueue computeQueue;
+    VkQueue computeQueue; // Simulation queue, graphicsQueue when there is no compute-only family
     VkQueue presentQueue;
 
     VkSwapchainKHR swapChain;
@@ -225,22 +381,37 @@ private:
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
+    std::vector<DeviceAllocation> offscreenImageAllocations; // Headless only: memory of swapChainImages
 
     VkRenderPass renderPass;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    AsyncPipeline graphicsPipeline;
 
     VkDescriptorSetLayout computeDescriptorSetLayout;
     VkPipelineLayout computePipelineLayout;
-    VkPipeline computePipeline;
+    AsyncPipeline computePipeline;
+    VkPipelineLayout particleInitPipelineLayout; // Shares the compute descriptor set layout
+    AsyncPipeline particleInitPipeline;
 
     VkCommandPool commandPool;
-
-    std::vector<VkBuffer> shaderStorageBuffers;
-    std::vector<VkDeviceMemory> shaderStorageBuffersMemory;
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE; // Only with a compute-only family
+
+    std::unique_ptr<VulkanMemoryBackend> memoryBackend;
+    std::unique_ptr<DeviceAllocator> allocator;
+
+    std::vector<VkBuffer> positionBuffers; // Particle states, one set per state slot, see simulationSlots()
+    std::vector<DeviceAllocation> positionBuffersAllocations;
+    std::vector<VkBuffer> previousPositionBuffers;
+    std::vector<DeviceAllocation> previousPositionBuffersAllocations;
+    std::vector<VkBuffer> velocityBuffers;
+    std::vector<DeviceAllocation> velocityBuffersAllocations;
+    VkBuffer colorBuffer; // Immutable after initializeParticles(), shared by all frames
+    DeviceAllocation colorBufferAllocation;
+    uint32_t maxComputeWorkGroupCountX = 65535; // Workgroups per dispatch, from the device limits
+    uint32_t particleSeed = 0; // Seed the particles were initialized with
 
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<DeviceAllocation> uniformBuffersAllocations;
     std::vector<void *> uniformBuffersMapped;
 
     VkDescriptorPool descriptorPool;
@@ -251,21 +422,27 @@ private:
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkSemaphore> computeFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> computeInFlightFences;
+    std::vector<VkSemaphore> stateReadySemaphores; // Per state slot: signaled by the step reading the state, waited by the frame drawing it
+    std::vector<VkFence> computeInFlightFences;    // Per state slot: the step writing the state
+    VkSemaphore particleInitSemaphore = VK_NULL_HANDLE; // Initial state handed to the compute-only family
     uint32_t currentFrame = 0;
+    uint64_t simulatedState = 0; // Newest state submitted to the compute queue, state 0 is the initial one
+    uint64_t drawnState = 0;     // State the next frame draws
 
-    float lastFrameTime = 0.0f;
+    FixedTimestep simulationClock; // Turns frame times into fixed simulation steps
+    std::vector<float> stateAlphas; // Per state slot: interpolation weight of its last step
+    uint64_t benchmarkFirstStep = 0; // Steps simulated before the measured frames
 
     bool framebufferResized = false;
 
-    double lastTime = 0.0f;
+    std::chrono::high_resolution_clock::time_point lastTime;
 
     /**
      * The given code initializes a window using the GLFW library and creates a non-resizable window for Vulkan
      * rendering. It sets up the necessary window hints, such as not using any specific graphics API by default. The
-     * window created has a fixed size of 800x600 pixels and a title of "Vulkan".
+     * window created has a size of 800x600 pixels unless set with --width and
+     * --height, and a title of "Vulkan".
      */
     void initWindow()
     {
@@ -273,11 +450,9 @@ private:
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int>(options.width), static_cast<int>(options.height), "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
-
-        lastTime = glfwGetTime();
     }
 
     /**
@@ -299,47 +474,277 @@ private:
     void initVulkan()
     {
         createInstance();
+        startup.mark("createInstance");
         setupDebugMessenger();
-        createSurface();
+        startup.mark("setupDebugMessenger");
+        if (!options.headless)
+        {
+            createSurface();
+            startup.mark("createSurface");
+        }
         pickPhysicalDevice();
+        startup.mark("pickPhysicalDevice");
         createLogicalDevice();
-        createSwapChain();
+        startup.mark("createLogicalDevice");
+        createAllocator();
+        startup.mark("createAllocator");
+        createPipelineCache();
+        startup.mark("createPipelineCache");
+        if (options.headless)
+        {
+            createOffscreenImages();
+            startup.mark("createOffscreenImages");
+        }
+        else
+        {
+            createSwapChain();
+            startup.mark("createSwapChain");
+        }
         createImageViews();
+        startup.mark("createImageViews");
         createRenderPass();
+        startup.mark("createRenderPass");
         createComputeDescriptorSetLayout();
+        startup.mark("createComputeDescriptorSetLayout");
         createGraphicsPipeline();
+        startup.mark("createGraphicsPipeline");
         createComputePipeline();
+        startup.mark("createComputePipeline");
         createFramebuffers();
+        startup.mark("createFramebuffers");
         createCommandPool();
+        startup.mark("createCommandPool");
         createShaderStorageBuffers();
+        startup.mark("createShaderStorageBuffers");
         createUniformBuffers();
+        startup.mark("createUniformBuffers");
         createDescriptorPool();
+        startup.mark("createDescriptorPool");
         createComputeDescriptorSets();
+        startup.mark("createComputeDescriptorSets");
+        initializeParticles();
+        startup.mark("initializeParticles");
         createCommandBuffers();
+        startup.mark("createCommandBuffers");
         createComputeCommandBuffers();
+        startup.mark("createComputeCommandBuffers");
         createSyncObjects();
+        startup.mark("createSyncObjects");
+        createGpuTimer();
+        startup.mark("createGpuTimer");
+        createFrameStatistics();
+        startup.mark("createFrameStatistics");
+        printAllocatorStats();
     }
 
     /**
-     * Loop that iterates until the window is closed. Once window is closed,
-     * deallocates resources we've used in the cleanup function
+     * Loop that iterates until the window is closed, or until --frames frames
+     * have been drawn. Once window is closed, deallocates resources we've used
+     * in the cleanup function
      */
     void mainLoop()
     {
-        while (!glfwWindowShouldClose(window))
+        auto startTime = std::chrono::high_resolution_clock::now();
+        uint32_t frameCount = 0;
+        lastTime = startTime;
+
+        while (options.headless ? frameCount < options.frames
+                                : !glfwWindowShouldClose(window) && (options.frames == 0 || frameCount < options.frames))
         {
-            glfwPollEvents();
+            if (!options.headless)
+            {
+                glfwPollEvents();
+            }
+            if (frameCount == options.warmupFrames)
+            {
+                benchmarkFirstStep = simulationClock.statistics().steps;
+            }
+            profiler.beginFrame();
             drawFrame();
+            profiler.endFrame();
+            endFrameStatistics();
+            if (frameCount == 0)
+            {
+                finishStartup("firstFrame");
+            }
+            frameCount++;
             /*
-             * We want to animate the particle system using the last frames time
-             * to get smooth, frame-rate independent animation
+             * The time the frame took is simulated in fixed steps by the next
+             * batches, so the animation neither depends on the frame rate nor
+             * jumps after a hitch
              */
-            double currentTime = glfwGetTime();
-            lastFrameTime = (currentTime - lastTime) * 1000.0;
+            auto currentTime = std::chrono::high_resolution_clock::now();
+            simulationClock.advance(std::chrono::duration<double, std::milli>(currentTime - lastTime).count());
             lastTime = currentTime;
         }
 
         vkDeviceWaitIdle(device);
+
+        if (gpuTimer)
+        {
+            gpuTimer->flush();
+            gpuTimer->report(std::cout);
+            gpuTimer->reportOverlap(std::cout, GPU_SCOPE_COMPUTE_DISPATCH, GPU_SCOPE_RENDER_PASS);
+        }
+
+        if (frameStatistics)
+        {
+            frameStatistics->flush();
+            frameStatistics->report(std::cout, static_cast<uint64_t>(swapChainExtent.width) * swapChainExtent.height);
+        }
+
+        if (options.benchmarkFrames > 0)
+        {
+            reportBenchmark();
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Rendered " << frameCount << " frames at " << swapChainExtent.width << "x" << swapChainExtent.height
+                  << " in " << milliseconds << " ms (" << (frameCount ? milliseconds / frameCount : 0.0) << " ms per frame)" << std::endl;
+
+        const FixedTimestepStats &steps = simulationClock.statistics();
+        std::cout << "Simulated " << steps.steps << " steps of " << simulationClock.stepMilliseconds() << " ms in "
+                  << steps.batches << " batches (" << (milliseconds > 0.0 ? steps.steps * 1000.0 / milliseconds : 0.0)
+                  << " steps per second), " << steps.cappedBatches << " batches hit --max-substeps and dropped "
+                  << steps.droppedMilliseconds << " ms" << std::endl;
+    }
+
+    /**
+     * Creates the pipeline cache, seeded from the file the previous run saved
+     * unless --no-pipeline-cache is given. It is written back in cleanup().
+     */
+    void createPipelineCache()
+    {
+        pipelineCache.reset(new PersistentPipelineCache(device, physicalDevice, options.pipelineCache));
+    }
+
+    /**
+     * Creates the timestamp queries behind --gpu-timestamps. Per-frame results
+     * go to the given CSV file, the summary is printed at exit.
+     */
+    void createGpuTimer()
+    {
+        if (options.gpuTimestamps.empty())
+        {
+            return;
+        }
+
+        gpuTimestampFile.open(options.gpuTimestamps);
+        if (!gpuTimestampFile)
+        {
+            throw std::runtime_error("failed to open " + options.gpuTimestamps + "!");
+        }
+
+        /* The render pass uses the frame slots, the dispatches the state slots */
+        gpuTimer.reset(new GpuTimer(device, physicalDevice, {queueFamilies.graphicsAndComputeFamily.value(), simulationFamily()}, simulationSlots(), {"render_pass", "compute_dispatch"}));
+        gpuTimer->setCsvOutput(&gpuTimestampFile);
+    }
+
+    /**
+     * Creates the counters behind --frame-stats. Pipeline statistics queries are
+     * only added if the device supports them.
+     */
+    void createFrameStatistics()
+    {
+        if (options.frameStatistics.empty())
+        {
+            return;
+        }
+
+        frameStatisticsFile.open(options.frameStatistics);
+        if (!frameStatisticsFile)
+        {
+            throw std::runtime_error("failed to open " + options.frameStatistics + "!");
+        }
+
+        frameStatistics.reset(new FrameStatistics(device, pipelineStatisticsEnabled, simulationSlots(), {"render_pass", "compute_dispatch"}));
+        frameStatistics->setCsvOutput(&frameStatisticsFile);
+    }
+
+    /**
+     * Hands the commands recorded for the frame just drawn to --frame-stats and
+     * starts counting the next one.
+     */
+    void endFrameStatistics()
+    {
+        if (frameStatistics)
+        {
+            frameStatistics->endFrame(commandCounters);
+        }
+        commandCounters = CommandCounters();
+    }
+
+    /**
+     * Closes the startup profile with 'stage', the work between the end of
+     * initVulkan() and the first frame (or the end of background work with
+     * --exit-after-init), and reports it if requested.
+     */
+    void finishStartup(const char *stage)
+    {
+        startup.mark(stage);
+        if (options.startupReport)
+        {
+            reportStartup();
+        }
+    }
+
+    /**
+     * Prints the time spent in each initialization stage and writes it to
+     * --startup-json if given.
+     */
+    void reportStartup()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        startup.setInfo("application", "particles");
+        startup.setInfo("device", properties.deviceName);
+        startup.setInfo("mode", options.headless ? "headless" : "windowed");
+        startup.setInfo("particles", std::to_string(options.particleCount));
+        startup.setInfo("seed", std::to_string(particleSeed));
+        startup.setInfo("compute_queue", queueFamilies.computeFamily.has_value() ? "dedicated" : "graphics");
+        startup.setInfo("simulation_lead", std::to_string(options.simulationLead));
+        startup.setInfo("pipeline_cache", pipelineCache->status());
+        startup.setInfo("pipeline_threads", std::to_string(pipelineCompiler.threadCount()));
+        startup.setInfo("graphics_pipeline_compile_ms", std::to_string(graphicsPipeline.compileMilliseconds()));
+        startup.setInfo("graphics_pipeline_wait_ms", std::to_string(graphicsPipeline.waitMilliseconds()));
+        startup.setInfo("compute_pipeline_compile_ms", std::to_string(computePipeline.compileMilliseconds()));
+        startup.setInfo("compute_pipeline_wait_ms", std::to_string(computePipeline.waitMilliseconds()));
+        startup.report(std::cout);
+
+        if (!options.startupJson.empty())
+        {
+            startup.writeJson(options.startupJson);
+            std::cout << "Startup report written to " << options.startupJson << std::endl;
+        }
+    }
+
+    /**
+     * Prints the benchmark results and writes them to --benchmark-json.
+     */
+    void reportBenchmark()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        profiler.setInfo("application", "particles");
+        profiler.setInfo("device", properties.deviceName);
+        profiler.setInfo("resolution", std::to_string(swapChainExtent.width) + "x" + std::to_string(swapChainExtent.height));
+        profiler.setInfo("mode", options.headless ? "headless" : "windowed");
+        profiler.setInfo("particles", std::to_string(options.particleCount));
+        profiler.setInfo("seed", std::to_string(particleSeed));
+        profiler.setInfo("compute_queue", queueFamilies.computeFamily.has_value() ? "dedicated" : "graphics");
+        profiler.setInfo("simulation_lead", std::to_string(options.simulationLead));
+        /* Steps submitted while the measured frames ran, at the frame rate the profiler measured */
+        double stepsPerFrame = profiler.measuredFrames() ? static_cast<double>(simulationClock.statistics().steps - benchmarkFirstStep) / profiler.measuredFrames() : 0.0;
+        double stepsPerSecond = stepsPerFrame * profiler.framesPerSecond();
+        profiler.setInfo("simulation_rate", std::to_string(options.simulationRate));
+        profiler.setInfo("max_substeps", std::to_string(options.maxSubsteps));
+        profiler.setInfo("steps_per_second", std::to_string(stepsPerSecond));
+        profiler.setInfo("particles_per_second", std::to_string(static_cast<uint64_t>(stepsPerSecond * options.particleCount)));
+        profiler.report(std::cout);
+        profiler.writeJson(options.benchmarkJson);
+        std::cout << "Benchmark report written to " << options.benchmarkJson << std::endl;
     }
 
     /**
@@ -360,7 +765,18 @@ private:
             vkDestroyImageView(device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (options.headless)
+        {
+            for (size_t i = 0; i < swapChainImages.size(); i++)
+            {
+                vkDestroyImage(device, swapChainImages[i], nullptr);
+                allocator->free(offscreenImageAllocations[i]);
+            }
+        }
+        else
+        {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
     }
 
     /**
@@ -371,41 +787,73 @@ private:
     {
         cleanupSwapChain();
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+        vkDestroyPipeline(device, graphicsPipeline.get(), nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-        vkDestroyPipeline(device, computePipeline, nullptr);
+        vkDestroyPipeline(device, computePipeline.get(), nullptr);
         vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
 
+        vkDestroyPipeline(device, particleInitPipeline.get(), nullptr);
+        vkDestroyPipelineLayout(device, particleInitPipelineLayout, nullptr);
+
         vkDestroyRenderPass(device, renderPass, nullptr);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < simulationSlots(); i++)
         {
             vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            allocator->free(uniformBuffersAllocations[i]);
         }
 
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
         vkDestroyDescriptorSetLayout(device, computeDescriptorSetLayout, nullptr);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < simulationSlots(); i++)
         {
-            vkDestroyBuffer(device, shaderStorageBuffers[i], nullptr);
-            vkFreeMemory(device, shaderStorageBuffersMemory[i], nullptr);
+            vkDestroyBuffer(device, positionBuffers[i], nullptr);
+            allocator->free(positionBuffersAllocations[i]);
+            vkDestroyBuffer(device, previousPositionBuffers[i], nullptr);
+            allocator->free(previousPositionBuffersAllocations[i]);
+            vkDestroyBuffer(device, velocityBuffers[i], nullptr);
+            allocator->free(velocityBuffersAllocations[i]);
         }
+        vkDestroyBuffer(device, colorBuffer, nullptr);
+        allocator->free(colorBufferAllocation);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
             vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroySemaphore(device, computeFinishedSemaphores[i], nullptr);
             vkDestroyFence(device, inFlightFences[i], nullptr);
+        }
+        for (size_t i = 0; i < simulationSlots(); i++)
+        {
+            vkDestroySemaphore(device, stateReadySemaphores[i], nullptr);
             vkDestroyFence(device, computeInFlightFences[i], nullptr);
         }
+        if (particleInitSemaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(device, particleInitSemaphore, nullptr);
+        }
 
+        if (computeCommandPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(device, computeCommandPool, nullptr);
+        }
         vkDestroyCommandPool(device, commandPool, nullptr);
 
+        gpuTimer.reset();
+        frameStatistics.reset();
+
+        if (!pipelineCache->save())
+        {
+            std::cerr << "failed to write pipeline cache " << options.pipelineCache << std::endl;
+        }
+        pipelineCache.reset();
+
+        allocator.reset();
+        memoryBackend.reset();
+
         vkDestroyDevice(device, nullptr);
 
         if (enableValidationLayers)
@@ -416,9 +864,12 @@ private:
         vkDestroySurfaceKHR(instance, surface, nullptr);
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
+        if (!options.headless)
+        {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
     }
 
     /**
@@ -612,6 +1063,7 @@ private:
      * device features, and validation layers if enabled.
      * If the logical device creation is successful, it retrieves the handle for
      * the graphics queue.
+     * A compute-only family, when present, gets a queue of its own for the simulation.
      */
     void createLogicalDevice()
     {
@@ -623,6 +1075,10 @@ private:
          */
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsAndComputeFamily.value(), indices.presentFamily.value()};
+        if (indices.computeFamily.has_value())
+        {
+            uniqueQueueFamilies.insert(indices.computeFamily.value());
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -637,6 +1093,15 @@ private:
 
         VkPhysicalDeviceFeatures deviceFeatures{};
 
+        /*
+         * Pipeline statistics queries are optional, --frame-stats falls back to
+         * CPU counters without them
+         */
+        VkPhysicalDeviceFeatures supportedFeatures{};
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        pipelineStatisticsEnabled = !options.frameStatistics.empty() && supportedFeatures.pipelineStatisticsQuery;
+        deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsEnabled ? VK_TRUE : VK_FALSE;
+
         /*
          * Logical device info struct
          */
@@ -651,8 +1116,9 @@ private:
         /*
          * Enable device extensions
          */
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        std::vector<const char *> extensions = requiredDeviceExtensions();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers)
         {
@@ -676,8 +1142,37 @@ private:
          * Retrieve graphics compute family and presentation family handles
          */
         vkGetDeviceQueue(device, indices.graphicsAndComputeFamily.value(), 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.graphicsAndComputeFamily.value(), 0, &computeQueue);
+        vkGetDeviceQueue(device, indices.computeFamily.value_or(indices.graphicsAndComputeFamily.value()), 0, &computeQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+        queueFamilies = indices;
+    }
+
+    /**
+     * Creates the device memory allocator that createBuffer() places buffers with.
+     */
+    void createAllocator()
+    {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        memoryBackend.reset(new VulkanMemoryBackend(device));
+        allocator.reset(new DeviceAllocator(*memoryBackend, memProperties, properties.limits.bufferImageGranularity));
+    }
+
+    /**
+     * Prints the allocator's block usage and fragmentation.
+     */
+    void printAllocatorStats()
+    {
+        DeviceAllocatorStats stats = allocator->stats();
+        std::cout << "Device memory: " << stats.allocationCount << " allocations in "
+                  << stats.blockCount << " blocks + " << stats.dedicatedAllocationCount << " dedicated, "
+                  << stats.bytesUsed / 1024 << " KiB used of " << stats.bytesReserved / 1024 << " KiB reserved, "
+                  << stats.bytesWasted << " bytes wasted, fragmentation " << stats.fragmentation << std::endl;
     }
 
     /**
@@ -768,6 +1263,52 @@ private:
         swapChainExtent = extent;
     }
 
+    /**
+     * Headless stand-in for createSwapChain(): creates one offscreen color image
+     * per frame in flight, in the format createSwapChain() prefers, and stores
+     * them as swapChainImages so that image views, framebuffers and command
+     * recording work unchanged. Frame slot i always renders into image i.
+     */
+    void createOffscreenImages()
+    {
+        swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        swapChainExtent = {options.width, options.height};
+
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < swapChainImages.size(); i++)
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = swapChainExtent.width;
+            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            /* Transfer source so frames can be read back */
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateImage(device, &imageInfo, nullptr, &swapChainImages[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create offscreen image!");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device, swapChainImages[i], &memRequirements);
+
+            offscreenImageAllocations[i] = allocator->allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), DeviceResourceKind::Optimal);
+
+            vkBindImageMemory(device, swapChainImages[i], offscreenImageAllocations[i].memory, offscreenImageAllocations[i].offset);
+        }
+    }
+
     /**
      * This function initializes a VkImageViewCreateInfo structure for each image in the swap chain,
      * and attempts to create an image view for it. Each image view is created with the 2D view type
@@ -835,7 +1376,8 @@ private:
          * Not applying stencil data
          */
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        /* Offscreen images are left ready to be copied out, as there is no presentation engine */
+        colorAttachment.finalLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         /*
          * Every subpass references one or more of attachments. We intend to use the
@@ -884,47 +1426,39 @@ private:
     }
 
     /**
-     * This function creates a descriptor set layout that consists of three bindings.
+     * This function creates a descriptor set layout that consists of six bindings.
      * The first binding is a uniform buffer that is used at the compute shader stage.
-     * The other two bindings are shader storage buffers also used at the compute shader stage.
+     * The others are shader storage buffers also used at the compute shader stage:
+     *
+     *      1, 2    positions and velocities of the last batch, read
+     *      3, 4    positions and velocities of this batch, written
+     *      5       colors, only written by particleInit.comp
+     *      6       previous positions of the last batch, read
+     *      7       previous positions of this batch, written
      *
      * This function constructs the layout by initializing a VkDescriptorSetLayoutCreateInfo
      * structure and populating it with information about the bindings.
      * It then attempts to create the descriptor set layout.
      *
-     * The reason for two shader storage buffer objects bindings is to store the particle system positions
+     * The reason for two sets of state bindings is to store the particle system positions
      * frame by frame based on a delta time. Each frame needs to know about the last frames' particle positions,
-     * so it can update them with a new delta time and write them to its own shader storage buffer.
+     * so it can update them with a new delta time and write them to its own shader storage buffers.
      */
     void createComputeDescriptorSetLayout()
     {
-        std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings{};
-        layoutBindings[0].binding = 0;
-        layoutBindings[0].descriptorCount = 1;
-        layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        layoutBindings[0].pImmutableSamplers = nullptr;
-        layoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-        /*
-         * We have two layout bindings for shader storage buffer objects, even though we'll only render a single particle system.
-         * This is because the particle positions are updated frame by frame based on a delta time.
-         * This means that each frame needs to know about the last frames' particle positions, so it can update them with a new delta time and write them to it's own SSBO:
-         */
-        layoutBindings[1].binding = 1;
-        layoutBindings[1].descriptorCount = 1;
-        layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        layoutBindings[1].pImmutableSamplers = nullptr;
-        layoutBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-        layoutBindings[2].binding = 2;
-        layoutBindings[2].descriptorCount = 1;
-        layoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        layoutBindings[2].pImmutableSamplers = nullptr;
-        layoutBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        std::array<VkDescriptorSetLayoutBinding, 8> layoutBindings{};
+        for (uint32_t i = 0; i < layoutBindings.size(); i++)
+        {
+            layoutBindings[i].binding = i;
+            layoutBindings[i].descriptorCount = 1;
+            layoutBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            layoutBindings[i].pImmutableSamplers = nullptr;
+            layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = 3;
+        layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
         layoutInfo.pBindings = layoutBindings.data();
 
         if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &computeDescriptorSetLayout) != VK_SUCCESS)
@@ -939,13 +1473,46 @@ private:
     void createGraphicsPipeline()
     {
         /*
-         * Creating fragment shader and vertex shader modules
+         * Sets up the pipeline layout
+         */
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 0;
+        pipelineLayoutInfo.pSetLayouts = nullptr;
+
+        /*
+         * The vertex shader gets the interpolation weight of the drawn state
          */
-        auto vertShaderCode = readFile("/Users/stevencheng/CLionProjects/VulkanTutorial/shaders/vertCompute.spv");
-        auto fragShaderCode = readFile("/Users/stevencheng/CLionProjects/VulkanTutorial/shaders/fragCompute.spv");
+        VkPushConstantRange interpolationRange{};
+        interpolationRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        interpolationRange.offset = 0;
+        interpolationRange.size = sizeof(float);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &interpolationRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
 
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        graphicsPipeline = pipelineCompiler.submit([this]()
+                                                   { return compileGraphicsPipeline(); });
+    }
+
+    /**
+     * Builds the graphics pipeline from the shaders and the fixed-function
+     * state. Runs on a pipeline compiler thread, so it only reads state that
+     * is fixed once createGraphicsPipeline() is called.
+     *
+     * @return The new pipeline.
+     */
+    VkPipeline compileGraphicsPipeline()
+    {
+        /*
+         * Creating fragment shader and vertex shader modules
+         */
+        VkShaderModule vertShaderModule = createShaderModule(findShader("vertCompute"));
+        VkShaderModule fragShaderModule = createShaderModule(findShader("fragCompute"));
 
         VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -967,12 +1534,12 @@ private:
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-        auto bindingDescription = Particle::getBindingDescription();
+        auto bindingDescriptions = Particle::getBindingDescriptions();
         auto attributeDescriptions = Particle::getAttributeDescriptions();
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         /*
@@ -1068,19 +1635,6 @@ private:
         dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
         dynamicState.pDynamicStates = dynamicStates.data();
 
-        /*
-         * Sets up the pipeline layout
-         */
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
         /*
          * Initializes graphics pipeline struct
          */
@@ -1112,13 +1666,16 @@ private:
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(device, pipelineCache->handle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
 
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+        return pipeline;
     }
 
     /**
@@ -1134,37 +1691,99 @@ private:
      */
     void createComputePipeline()
     {
-        auto computeShaderCode = readFile("/Users/stevencheng/CLionProjects/VulkanTutorial/shaders/comp.spv");
-
-        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
-
-        VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
-        computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        computeShaderStageInfo.module = computeShaderModule;
-        computeShaderStageInfo.pName = "main";
-
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = 1;
         pipelineLayoutInfo.pSetLayouts = &computeDescriptorSetLayout;
 
+        /*
+         * Each dispatch gets the particle range it covers through push constants
+         */
+        VkPushConstantRange dispatchRange{};
+        dispatchRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        dispatchRange.offset = 0;
+        dispatchRange.size = sizeof(DispatchRange);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &dispatchRange;
+
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create compute pipeline layout!");
         }
 
-        VkComputePipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-        pipelineInfo.layout = computePipelineLayout;
-        pipelineInfo.stage = computeShaderStageInfo;
+        computePipeline = pipelineCompiler.submit([this]()
+                                                  { return compileComputePipeline(); });
+
+        /*
+         * The particle initializer also gets its seed and the aspect ratio
+         */
+        VkPushConstantRange initRange{};
+        initRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        initRange.offset = 0;
+        initRange.size = sizeof(DispatchRange) + sizeof(ParticleInitParameters);
+        pipelineLayoutInfo.pPushConstantRanges = &initRange;
 
-        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &particleInitPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create particle init pipeline layout!");
+        }
+
+        particleInitPipeline = pipelineCompiler.submit([this]()
+                                                       { return compileParticleInitPipeline(); });
+    }
+
+    /**
+     * Builds the particle compute pipeline. Runs on a pipeline compiler thread,
+     * like compileGraphicsPipeline().
+     *
+     * @return The new pipeline.
+     */
+    VkPipeline compileComputePipeline()
+    {
+        return compileParticlePipeline("comp", computePipelineLayout);
+    }
+
+    /**
+     * Builds the pipeline of initializeParticles(), on a pipeline compiler thread.
+     *
+     * @return The new pipeline.
+     */
+    VkPipeline compileParticleInitPipeline()
+    {
+        return compileParticlePipeline("particleInit", particleInitPipelineLayout);
+    }
+
+    /**
+     * Builds a compute pipeline from an embedded shader.
+     *
+     * @param shader Name of the compute shader.
+     * @param layout Pipeline layout matching the shader.
+     * @return The new pipeline.
+     */
+    VkPipeline compileParticlePipeline(const char *shader, VkPipelineLayout layout)
+    {
+        VkShaderModule computeShaderModule = createShaderModule(findShader(shader));
+
+        VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
+        computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        computeShaderStageInfo.module = computeShaderModule;
+        computeShaderStageInfo.pName = "main";
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.layout = layout;
+        pipelineInfo.stage = computeShaderStageInfo;
+
+        VkPipeline pipeline;
+        if (vkCreateComputePipelines(device, pipelineCache->handle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create compute pipeline!");
         }
 
         vkDestroyShaderModule(device, computeShaderModule, nullptr);
+
+        return pipeline;
     }
 
     /**
@@ -1218,125 +1837,330 @@ private:
         {
             throw std::runtime_error("failed to create graphics command pool!");
         }
+
+        if (queueFamilies.computeFamily.has_value())
+        {
+            /* Simulation command buffers are re-recorded every step, like the graphics ones */
+            VkCommandPoolCreateInfo computePoolInfo{};
+            computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            computePoolInfo.queueFamilyIndex = queueFamilies.computeFamily.value();
+
+            if (vkCreateCommandPool(device, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create compute command pool!");
+            }
+        }
     }
 
     /**
-     * In this function, we're initially generating data for a particle system where particles are randomly distributed on
-     * a circle. The data includes the initial positions, velocities and colors of the particles.
-     *
-     * As GPUs typically can't directly access CPU memory (where our initial particles' data is), we need to use a
-     * staging buffer - a temporary buffer that the CPU can write to and the GPU can read from. The staging buffer is
-     * created in host-visible memory, which means it's accessible by the CPU. After creating the staging buffer, we
-     * copy the data for the initial particles' positions, velocities and colors to this buffer.
+     * Creates the particle buffers in device-local memory: positions, previous
+     * positions and velocities once per state slot (see simulationSlots()), and
+     * one color buffer that never changes. Both positions and the colors are
+     * also the vertex buffers of the particle draw.
      *
-     * Once the data is in the staging buffer, we then create the actual shader storage buffers where the data will
-     * reside on the GPU, and copy the data from the staging buffer to these. As there might be multiple frames being
-     * processed simultaneously (indicated by MAX_FRAMES_IN_FLIGHT), we need to create a separate buffer for each frame
-     * to avoid synchronization issues.
-     *
-     * After the data has been transferred to the GPU, we can safely destroy the staging buffer and free the associated memory.
+     * Their contents are generated on the GPU by initializeParticles(), so no
+     * particle ever exists in host memory or passes through a staging buffer.
      */
     void createShaderStorageBuffers()
     {
-        /*
-         * Initialize particles
-         */
-        std::default_random_engine rndEngine((unsigned)time(nullptr));
-        std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+        checkParticleLimits();
 
-        /*
-         * Initial particle positions on a circle
-         */
-        std::vector<Particle> particles(PARTICLE_COUNT);
-        for (auto &particle : particles)
+        positionBuffers.resize(simulationSlots());
+        positionBuffersAllocations.resize(simulationSlots());
+        previousPositionBuffers.resize(simulationSlots());
+        previousPositionBuffersAllocations.resize(simulationSlots());
+        velocityBuffers.resize(simulationSlots());
+        velocityBuffersAllocations.resize(simulationSlots());
+
+        for (size_t i = 0; i < simulationSlots(); i++)
         {
-            float r = 0.25f * sqrt(rndDist(rndEngine));
-            float theta = rndDist(rndEngine) * 2.0f * 3.14159265358979323846f;
-            float x = r * cos(theta) * HEIGHT / WIDTH;
-            float y = r * sin(theta);
-            particle.position = glm::vec2(x, y);
-            particle.velocity = glm::normalize(glm::vec2(x, y)) * 0.00025f;
-            particle.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
+            createBuffer(particleArraySize(sizeof(Particle::Position)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, positionBuffers[i], positionBuffersAllocations[i]);
+            createBuffer(particleArraySize(sizeof(Particle::Position)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, previousPositionBuffers[i], previousPositionBuffersAllocations[i]);
+            createBuffer(particleArraySize(sizeof(Particle::Velocity)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, velocityBuffers[i], velocityBuffersAllocations[i]);
         }
 
-        VkDeviceSize bufferSize = sizeof(Particle) * PARTICLE_COUNT;
+        createBuffer(particleArraySize(sizeof(Particle::Color)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorBuffer, colorBufferAllocation);
+    }
 
-        /*
-         * Create a staging buffer used to upload data to the gpu
-         */
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    /**
+     * Fills the particle buffers with the initial particles: uniformly
+     * distributed over a disc of radius 0.25, moving outwards, with random
+     * colors. particleInit.comp draws the random numbers from a counter-based
+     * generator, so a particle only depends on its index and the seed, and
+     * --seed reproduces a run exactly.
+     *
+     * The dispatches are submitted to the graphics and compute queue ahead of
+     * the first frame and end with a barrier, so the first frame only relies on
+     * queue submission order and the host never waits.
+     * Only state 0 and the colors are written, every later state is computed
+     * before it is read. With a compute-only family, state 0 is released to it
+     * and the first simulation step waits for particleInitSemaphore.
+     */
+    void initializeParticles()
+    {
+        particleSeed = options.seed.value_or(static_cast<uint32_t>(time(nullptr)));
 
-        void *data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, particles.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        VkCommandBuffer commandBuffer = beginOneTimeCommands();
 
-        shaderStorageBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        shaderStorageBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleInitPipeline.get());
 
-        /*
-         * Copy initial particle data to all storage buffers
-         */
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        /* The output bindings of compute descriptor set 0 are the buffers of state 0 */
+        ParticleInitParameters parameters{};
+        parameters.seed = particleSeed;
+        parameters.aspectRatio = static_cast<float>(swapChainExtent.height) / swapChainExtent.width;
+        parameters.writeColors = 1;
+        vkCmdPushConstants(commandBuffer, particleInitPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(DispatchRange), sizeof(ParticleInitParameters), &parameters);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleInitPipelineLayout, 0, 1, &computeDescriptorSets[0], 0, nullptr);
+        recordParticleDispatches(commandBuffer, particleInitPipelineLayout);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        if (!queueFamilies.computeFamily.has_value())
+        {
+            submitOneTimeCommands(commandBuffer);
+            return;
+        }
+
+        /* The colors stay with the graphics family, which is their only reader */
+        uint32_t graphicsFamily = queueFamilies.graphicsAndComputeFamily.value();
+        uint32_t computeFamily = queueFamilies.computeFamily.value();
+        for (VkBuffer buffer : {positionBuffers[0], previousPositionBuffers[0], velocityBuffers[0]})
+        {
+            recordParticleOwnershipTransfer(commandBuffer, buffer, graphicsFamily, computeFamily, true, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &particleInitSemaphore) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create particle init semaphore!");
+        }
+
+        submitOneTimeCommands(commandBuffer, particleInitSemaphore);
+    }
+
+    /**
+     * Allocates a primary command buffer from the graphics and compute command
+     * pool and begins recording it for a single submission.
+     */
+    VkCommandBuffer beginOneTimeCommands()
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate one-time command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording one-time command buffer!");
+        }
+        return commandBuffer;
+    }
+
+    /**
+     * Ends a command buffer from beginOneTimeCommands() and submits it to the
+     * graphics and compute queue without waiting for it. It is only used at
+     * startup, so it is not freed until the command pool is destroyed.
+     *
+     * @param signalSemaphore Signaled when the commands have executed, optional.
+     */
+    void submitOneTimeCommands(VkCommandBuffer commandBuffer, VkSemaphore signalSemaphore = VK_NULL_HANDLE)
+    {
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record one-time command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (signalSemaphore != VK_NULL_HANDLE)
         {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shaderStorageBuffers[i], shaderStorageBuffersMemory[i]);
-            copyBuffer(stagingBuffer, shaderStorageBuffers[i], bufferSize);
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &signalSemaphore;
         }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit one-time command buffer!");
+        }
+    }
+
+    /**
+     * Records one half of a queue family ownership transfer of a particle
+     * buffer. The release half is recorded on the queue that wrote the buffer,
+     * the acquire half with the same family indices on the queue that reads it
+     * next.
+     *
+     * @param srcQueueFamily Family that wrote the buffer.
+     * @param dstQueueFamily Family that uses the buffer from now on.
+     * @param release True for the release half, false for the acquire half.
+     * @param stage Stage of the writes for the release half, of the reads for the acquire half.
+     * @param access Access of the writes for the release half, of the reads for the acquire half.
+     */
+    void recordParticleOwnershipTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+                                         bool release, VkPipelineStageFlags stage, VkAccessFlags access)
+    {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = release ? access : 0;
+        barrier.dstAccessMask = release ? 0 : access;
+        barrier.srcQueueFamilyIndex = srcQueueFamily;
+        barrier.dstQueueFamilyIndex = dstQueueFamily;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        VkPipelineStageFlags srcStage = release ? stage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        VkPipelineStageFlags dstStage = release ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) : stage;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
     }
 
     /**
-     * This method creates uniform buffers for each frame in flight, based on the `MAX_FRAMES_IN_FLIGHT` constant.
+     * Records the dispatches of the bound particle compute pipeline: one
+     * invocation per particle, rounded up to whole workgroups. Counts past
+     * maxComputeWorkGroupCount[0] workgroups take several dispatches, each told
+     * where its range starts through the DispatchRange at push constant offset 0.
+     *
+     * @param layout Layout of the bound pipeline.
+     * @return The number of dispatches recorded.
+     */
+    uint32_t recordParticleDispatches(VkCommandBuffer commandBuffer, VkPipelineLayout layout)
+    {
+        uint32_t dispatchCount = 0;
+        uint32_t groupCount = (options.particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE;
+        for (uint32_t firstGroup = 0; firstGroup < groupCount; firstGroup += maxComputeWorkGroupCountX)
+        {
+            DispatchRange range{};
+            range.particleCount = options.particleCount;
+            range.firstParticle = firstGroup * PARTICLE_WORKGROUP_SIZE;
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DispatchRange), &range);
+
+            vkCmdDispatch(commandBuffer, std::min(maxComputeWorkGroupCountX, groupCount - firstGroup), 1, 1);
+            dispatchCount++;
+        }
+        return dispatchCount;
+    }
+
+    /**
+     * Number of particle states kept on the GPU. While a frame draws state N,
+     * the compute queue may be working on the steps up to N + --simulation-lead,
+     * and the previous frame in flight may still be drawing state N - 1. Every
+     * one of those states needs its own buffers, uniform buffer, descriptor set
+     * and command buffer, all indexed by state % simulationSlots().
+     */
+    uint32_t simulationSlots() const
+    {
+        return options.simulationLead + MAX_FRAMES_IN_FLIGHT;
+    }
+
+    /**
+     * @return Queue family the simulation steps are submitted to.
+     */
+    uint32_t simulationFamily() const
+    {
+        return queueFamilies.computeFamily.value_or(queueFamilies.graphicsAndComputeFamily.value());
+    }
+
+    /**
+     * @return Size in bytes of a particle array with elements of 'elementSize' bytes.
+     */
+    VkDeviceSize particleArraySize(VkDeviceSize elementSize) const
+    {
+        return elementSize * options.particleCount;
+    }
+
+    /**
+     * Checks --particles against the device: each particle array must fit in
+     * one storage buffer descriptor range. Also reads the workgroup count limit that
+     * recordComputeCommandBuffer() splits dispatches at.
+     */
+    void checkParticleLimits()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        maxComputeWorkGroupCountX = properties.limits.maxComputeWorkGroupCount[0];
+
+        /* Positions and velocities have the largest elements */
+        if (particleArraySize(sizeof(Particle::Position)) > properties.limits.maxStorageBufferRange)
+        {
+            throw std::runtime_error(std::to_string(options.particleCount) + " particles exceed the storage buffer range of " +
+                                     properties.deviceName + ", which holds at most " +
+                                     std::to_string(properties.limits.maxStorageBufferRange / sizeof(Particle::Position)) + "!");
+        }
+    }
+
+    /**
+     * This method creates uniform buffers for each state slot, see simulationSlots().
      * The buffer size is determined by the size of the `UniformBufferObject` structure.
-     * The method resizes the `uniformBuffers`, `uniformBuffersMemory`, and `uniformBuffersMapped` vectors to accommodate the buffers for each frame.
+     * The method resizes the `uniformBuffers`, `uniformBuffersAllocations`, and `uniformBuffersMapped` vectors to accommodate the buffers for each frame.
      * It then iterates over each frame and calls the `createBuffer` function to create the uniform buffer,
      * specifying the buffer size, usage flags, and memory properties.
-     * Finally, it maps the memory of each uniform buffer for host visibility and coherence.
+     * The allocator keeps host-visible memory mapped, so the mapped pointers are taken from the allocations.
      */
     void createUniformBuffers()
     {
         VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-        uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffers.resize(simulationSlots());
+        uniformBuffersAllocations.resize(simulationSlots());
+        uniformBuffersMapped.resize(simulationSlots());
+        stateAlphas.assign(simulationSlots(), 0.0f);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < simulationSlots(); i++)
         {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersAllocations[i]);
 
-            vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+            uniformBuffersMapped[i] = uniformBuffersAllocations[i].mapped;
         }
     }
 
     /**
      * In this function, we are defining two types of descriptors: uniform buffers and storage buffers. The uniform buffer
      * descriptor is used for passing uniform data (data that doesn't change frequently) to shaders. The storage buffer
-     * descriptor is used for passing data that can be read from and written to by shaders. Since we may be processing
-     * multiple frames simultaneously (as indicated by MAX_FRAMES_IN_FLIGHT), we ensure the pool size accounts for this
-     * by setting the descriptor count for each type according to the number of frames in flight.
+     * descriptor is used for passing data that can be read from and written to by shaders. Since several simulation
+     * steps may be in flight at once (see simulationSlots()), we ensure the pool size accounts for this by setting the
+     * descriptor count for each type according to the number of state slots.
      *
-     * The number of descriptor sets that can be allocated from the pool is also set to the number of frames in flight. This
-     * is because we create one descriptor set per frame, which is matched to the shader storage buffers created for each frame.
+     * The number of descriptor sets that can be allocated from the pool is also set to the number of state slots. This
+     * is because we create one descriptor set per slot, which is matched to the shader storage buffers created for each slot.
      */
     void createDescriptorPool()
     {
         std::array<VkDescriptorPoolSize, 2> poolSizes{};
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[0].descriptorCount = simulationSlots();
 
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+        poolSizes[1].descriptorCount = simulationSlots() * 7;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = 2;
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = simulationSlots();
 
         if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
         {
@@ -1345,16 +2169,16 @@ private:
     }
 
     /**
-     * The primary purpose of this function is to create the necessary descriptor sets for each frame in flight. We need
-     * to do this because Vulkan allows us to process multiple frames simultaneously. Each frame will need its own set
-     * of resources to work with, which is why we create a separate descriptor set for each frame. The number of descriptor
-     * sets is given by MAX_FRAMES_IN_FLIGHT.
+     * The primary purpose of this function is to create the necessary descriptor sets for each state slot. We need
+     * to do this because several simulation steps may be queued at once. Each step will need its own set of resources
+     * to work with, which is why we create a separate descriptor set for each slot. The number of descriptor sets is
+     * given by simulationSlots().
      *
-     * Each descriptor set includes bindings for a uniform buffer and two storage buffers. The uniform buffer stores
-     * data that remains constant across all shader invocations within a frame (such as transformation matrices). The two
-     * storage buffers are for storing the particle data from the previous and current frames. The reason for having two
-     * storage buffers is to enable time-dependent calculations that use data from the current and previous frames (e.g.,
-     * for calculating particle movement).
+     * Each descriptor set includes bindings for a uniform buffer and seven storage buffers. The uniform buffer stores
+     * data that remains constant across all shader invocations within a batch (such as the time step). Two sets of
+     * position, previous position and velocity buffers hold the particle states of the previous and current slots, to
+     * enable time-dependent calculations that use data from the current and previous batches (e.g., for calculating
+     * particle movement). Binding 5 is the color buffer that all states share.
      *
      * These resources are then connected to the shaders through the descriptor sets. By updating the descriptor sets with
      * the appropriate buffer information for each frame, we provide a mechanism for the shaders to access per-frame data
@@ -1362,62 +2186,46 @@ private:
      */
     void createComputeDescriptorSets()
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, computeDescriptorSetLayout);
+        std::vector<VkDescriptorSetLayout> layouts(simulationSlots(), computeDescriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.descriptorSetCount = simulationSlots();
         allocInfo.pSetLayouts = layouts.data();
 
-        computeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        computeDescriptorSets.resize(simulationSlots());
         if (vkAllocateDescriptorSets(device, &allocInfo, computeDescriptorSets.data()) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to allocate descriptor sets!");
         }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < simulationSlots(); i++)
         {
-            VkDescriptorBufferInfo uniformBufferInfo{};
-            uniformBufferInfo.buffer = uniformBuffers[i];
-            uniformBufferInfo.offset = 0;
-            uniformBufferInfo.range = sizeof(UniformBufferObject);
-
-            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = computeDescriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &uniformBufferInfo;
+            size_t lastSlot = (i + simulationSlots() - 1) % simulationSlots();
 
-            VkDescriptorBufferInfo storageBufferInfoLastFrame{};
-            storageBufferInfoLastFrame.buffer = shaderStorageBuffers[(i - 1) % MAX_FRAMES_IN_FLIGHT];
-            storageBufferInfoLastFrame.offset = 0;
-            storageBufferInfoLastFrame.range = sizeof(Particle) * PARTICLE_COUNT;
+            std::array<VkDescriptorBufferInfo, 8> bufferInfos{};
+            bufferInfos[0] = {uniformBuffers[i], 0, sizeof(UniformBufferObject)};
+            bufferInfos[1] = {positionBuffers[lastSlot], 0, particleArraySize(sizeof(Particle::Position))};
+            bufferInfos[2] = {velocityBuffers[lastSlot], 0, particleArraySize(sizeof(Particle::Velocity))};
+            bufferInfos[3] = {positionBuffers[i], 0, particleArraySize(sizeof(Particle::Position))};
+            bufferInfos[4] = {velocityBuffers[i], 0, particleArraySize(sizeof(Particle::Velocity))};
+            bufferInfos[5] = {colorBuffer, 0, particleArraySize(sizeof(Particle::Color))};
+            bufferInfos[6] = {previousPositionBuffers[lastSlot], 0, particleArraySize(sizeof(Particle::Position))};
+            bufferInfos[7] = {previousPositionBuffers[i], 0, particleArraySize(sizeof(Particle::Position))};
 
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = computeDescriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pBufferInfo = &storageBufferInfoLastFrame;
-
-            VkDescriptorBufferInfo storageBufferInfoCurrentFrame{};
-            storageBufferInfoCurrentFrame.buffer = shaderStorageBuffers[i];
-            storageBufferInfoCurrentFrame.offset = 0;
-            storageBufferInfoCurrentFrame.range = sizeof(Particle) * PARTICLE_COUNT;
-
-            descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[2].dstSet = computeDescriptorSets[i];
-            descriptorWrites[2].dstBinding = 2;
-            descriptorWrites[2].dstArrayElement = 0;
-            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            descriptorWrites[2].descriptorCount = 1;
-            descriptorWrites[2].pBufferInfo = &storageBufferInfoCurrentFrame;
+            std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+            {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = computeDescriptorSets[i];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
 
-            vkUpdateDescriptorSets(device, 3, descriptorWrites.data(), 0, nullptr);
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
         }
     }
 
@@ -1429,9 +2237,10 @@ private:
      * @param usage The usage flags specifying how the buffer will be used.
      * @param properties The memory property flags defining the desired memory properties for the buffer.
      * @param buffer Reference to a VkBuffer variable to store the created buffer handle.
-     * @param bufferMemory Reference to a VkDeviceMemory variable to store the allocated device memory for the buffer.
+     * @param bufferAllocation Reference to a DeviceAllocation variable to store the buffer's memory range.
+     *        For host-visible memory its 'mapped' member points at the buffer contents.
      */
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, DeviceAllocation &bufferAllocation)
     {
         /*
          * Define class member to hold the buffer handle
@@ -1448,83 +2257,17 @@ private:
         }
 
         /*
-         * Determine the right memory type for the buffer and allocate memory
+         * Determine the right memory type for the buffer and sub-allocate memory
          */
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to allocate buffer memory!");
-        }
-
-        /*
-         * Associate memory with the buffer, fill the vertex buffer, then
-         * unmaps the memory allocated for the buffer.
-         */
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
-    }
+        bufferAllocation = allocator->allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), DeviceResourceKind::Linear);
 
-    /**
-     * This method encapsulates the Vulkan commands necessary for data transfer between GPU and CPU.
-     * Such transfers are often required for uploading data (vertices, indices, textures, computed data) to the GPU.
-     * The function allocates a temporary command buffer for the transfer, records the buffer copy operation,
-     * and submits it to the graphics queue. The method ensures the completion of operation before returning by
-     * waiting for the queue to become idle.
-     *
-     * @param srcBuffer The source buffer from which the data is copied.
-     * @param dstBuffer The destination buffer to which the data is transferred.
-     * @param size Size of the data to be transferred.
-     */
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-    {
         /*
-         * Allocate temporary command buffer for transfer
+         * Associate the allocated range with the buffer
          */
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-        /*
-         * Start recording command buffer
-         */
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-        /*
-         * Copies a specified size of data from a source buffer to a destination buffer in Vulkan using a specific command buffer.
-         */
-        VkBufferCopy copyRegion{};
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-        vkEndCommandBuffer(commandBuffer);
-
-        /*
-         * Create queue info and execute the transfer on the buffers immediately
-         */
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        vkBindBufferMemory(device, buffer, bufferAllocation.memory, bufferAllocation.offset);
     }
 
     /**
@@ -1583,17 +2326,17 @@ private:
      * the compute pipeline operations on the device. In Vulkan, commands like drawing operations and memory
      * transfers are not executed directly using function calls. They are first recorded into a command buffer
      * object, which can then be submitted to a device queue to execute the operations that are recorded in the
-     * buffer. By pre-allocating these buffers in accordance with the maximum number of frames in flight, we
+     * buffer. By pre-allocating one buffer per state slot, from the pool of the simulation's queue family, we
      * ensure the efficient use of system resources and prepare for the execution of compute operations in a
      * controlled, asynchronous manner.
      */
     void createComputeCommandBuffers()
     {
-        computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        computeCommandBuffers.resize(simulationSlots());
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = commandPool;
+        allocInfo.commandPool = computeCommandPool != VK_NULL_HANDLE ? computeCommandPool : commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandBufferCount = (uint32_t)computeCommandBuffers.size();
 
@@ -1608,9 +2351,13 @@ private:
      * Each command buffer represents a unit of work to be performed by the GPU, and recording these commands ahead of time optimizes the
      *          rendering process by predefining the workload for each frame in a consistent and predictable manner. Recording commands involves not only
      *          specifying which operations will be performed, but also setting up the necessary state information and resources required by these operations.
+     *
+     * @param state Particle state to draw.
      */
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint64_t state)
     {
+        uint32_t slot = static_cast<uint32_t>(state % simulationSlots());
+
         /*
          * Initialize command buffer
          */
@@ -1622,6 +2369,19 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        /*
+         * Acquire half of the positions' hand-over, see recordComputeCommandBuffer()
+         */
+        if (queueFamilies.computeFamily.has_value())
+        {
+            for (VkBuffer buffer : {positionBuffers[slot], previousPositionBuffers[slot]})
+            {
+                recordParticleOwnershipTransfer(commandBuffer, buffer, queueFamilies.computeFamily.value(), queueFamilies.graphicsAndComputeFamily.value(),
+                                                false, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+                commandCounters.barriers++;
+            }
+        }
+
         /*
          * Initializing render pass
          */
@@ -1637,13 +2397,23 @@ private:
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
+        if (gpuTimer)
+        {
+            gpuTimer->begin(commandBuffer, currentFrame, GPU_SCOPE_RENDER_PASS);
+        }
+        if (frameStatistics)
+        {
+            frameStatistics->begin(commandBuffer, currentFrame, GPU_SCOPE_RENDER_PASS);
+        }
+
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
         /*
          * Bind graphics pipeline by specifying pipeline is a graphics one.
          * Then, specify viewport and scissor state for this pipeline to be dynamic.
          */
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.get());
+        commandCounters.pipelineBinds++;
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -1659,15 +2429,31 @@ private:
         scissor.extent = swapChainExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        VkDeviceSize offsets[] = {0};
+        VkBuffer vertexBuffers[] = {positionBuffers[slot], colorBuffer, previousPositionBuffers[slot]};
+        VkDeviceSize offsets[] = {0, 0, 0};
         uint32_t firstBinding = 0;
-        uint32_t bindingCount = 1;
-        vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, &shaderStorageBuffers[currentFrame], offsets);
+        uint32_t bindingCount = 3;
+        vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, vertexBuffers, offsets);
+        commandCounters.bufferBinds += 3;
+
+        /* Shows the simulation between its last two steps, see FixedTimestep */
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float), &stateAlphas[slot]);
 
-        vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
+        vkCmdDraw(commandBuffer, options.particleCount, 1, 0, 0);
+        commandCounters.draws++;
 
         vkCmdEndRenderPass(commandBuffer);
 
+        if (frameStatistics)
+        {
+            frameStatistics->end(commandBuffer, currentFrame, GPU_SCOPE_RENDER_PASS);
+        }
+
+        if (gpuTimer)
+        {
+            gpuTimer->end(commandBuffer, currentFrame, GPU_SCOPE_RENDER_PASS);
+        }
+
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to record command buffer!");
@@ -1680,9 +2466,20 @@ private:
      * times. By encoding operations like dispatching a compute shader to process a batch of data, and allowing them to be
      * queued for later execution, this method effectively reduces the load on the CPU while providing a significant boost in
      * execution efficiency.
+     *
+     * Step N reads state N - 1 and writes state N, running the batch's substeps in one dispatch. With a compute-only
+     * family, the step also hands state N - 1's positions and previous positions over to the graphics family once it
+     * has read them: the frame drawing state N - 1 waits for step N. Velocities never leave the compute family. A
+     * state slot is overwritten without taking its positions back, as the step replaces all of their contents.
+     *
+     * @param step Simulation batch, 1 for the first.
      */
-    void recordComputeCommandBuffer(VkCommandBuffer commandBuffer)
+    void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint64_t step)
     {
+        uint32_t slot = static_cast<uint32_t>(step % simulationSlots());
+        uint32_t lastSlot = static_cast<uint32_t>((step - 1) % simulationSlots());
+        bool ownershipTransfers = queueFamilies.computeFamily.has_value();
+
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -1691,11 +2488,68 @@ private:
             throw std::runtime_error("failed to begin recording compute command buffer!");
         }
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+        if (gpuTimer)
+        {
+            gpuTimer->begin(commandBuffer, slot, GPU_SCOPE_COMPUTE_DISPATCH);
+        }
+        /* Pipeline statistics queries count graphics stages, which a compute-only queue can't */
+        if (frameStatistics && !ownershipTransfers)
+        {
+            frameStatistics->begin(commandBuffer, slot, GPU_SCOPE_COMPUTE_DISPATCH);
+        }
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[currentFrame], 0, nullptr);
+        /*
+         * Steps follow each other on the queue without waiting on the host, so
+         * the previous step's writes must be visible before this one reads
+         * them, and its reads done before this one overwrites a slot
+         */
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-        vkCmdDispatch(commandBuffer, PARTICLE_COUNT / 256, 1, 1);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        commandCounters.barriers++;
+
+        /* State 0 was written on the graphics queue, see initializeParticles() */
+        if (ownershipTransfers && step == 1)
+        {
+            uint32_t graphicsFamily = queueFamilies.graphicsAndComputeFamily.value();
+            uint32_t computeFamily = queueFamilies.computeFamily.value();
+            for (VkBuffer buffer : {positionBuffers[0], previousPositionBuffers[0], velocityBuffers[0]})
+            {
+                recordParticleOwnershipTransfer(commandBuffer, buffer, graphicsFamily, computeFamily, false, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+                commandCounters.barriers++;
+            }
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.get());
+        commandCounters.pipelineBinds++;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[slot], 0, nullptr);
+        commandCounters.descriptorSetBinds++;
+
+        commandCounters.dispatches += recordParticleDispatches(commandBuffer, computePipelineLayout);
+
+        if (ownershipTransfers)
+        {
+            for (VkBuffer buffer : {positionBuffers[lastSlot], previousPositionBuffers[lastSlot]})
+            {
+                recordParticleOwnershipTransfer(commandBuffer, buffer, queueFamilies.computeFamily.value(), queueFamilies.graphicsAndComputeFamily.value(),
+                                                true, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+                commandCounters.barriers++;
+            }
+        }
+
+        if (frameStatistics && !ownershipTransfers)
+        {
+            frameStatistics->end(commandBuffer, slot, GPU_SCOPE_COMPUTE_DISPATCH);
+        }
+
+        if (gpuTimer)
+        {
+            gpuTimer->end(commandBuffer, slot, GPU_SCOPE_COMPUTE_DISPATCH);
+        }
 
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
@@ -1711,9 +2565,9 @@ private:
     {
         imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        stateReadySemaphores.resize(simulationSlots());
+        computeInFlightFences.resize(simulationSlots());
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1730,120 +2584,190 @@ private:
             {
                 throw std::runtime_error("failed to create graphics synchronization objects for a frame!");
             }
-            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS ||
+        }
+
+        for (size_t i = 0; i < simulationSlots(); i++)
+        {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &stateReadySemaphores[i]) != VK_SUCCESS ||
                 vkCreateFence(device, &fenceInfo, nullptr, &computeInFlightFences[i]) != VK_SUCCESS)
             {
-                throw std::runtime_error("failed to create compute synchronization objects for a frame!");
+                throw std::runtime_error("failed to create compute synchronization objects for a state!");
             }
         }
     }
 
     /**
-     * This function dynamically updates the uniform buffer object (UBO) for each frame, providing flexibility in manipulating
+     * This function dynamically updates the uniform buffer object (UBO) for each batch, providing flexibility in manipulating
      * uniform variables during runtime. Vulkan requires explicit handling of buffer memory, hence updating buffers like
-     * this is often used for frequently changing data. In this case, the 'deltaTime' is updated for each frame, which can
-     * be used for time-dependent computations in the shaders, like animations, transformations, or physics simulations.
+     * this is often used for frequently changing data. In this case, the fixed 'deltaTime' and the number of substeps
+     * the batch runs are written, which comp.comp uses to integrate the particles.
      */
-    void updateUniformBuffer(uint32_t currentImage)
+    void updateUniformBuffer(uint32_t slot, const SimulationBatch &batch)
     {
         UniformBufferObject ubo{};
-        ubo.deltaTime = lastFrameTime * 2.0f;
+        ubo.deltaTime = static_cast<float>(simulationClock.stepMilliseconds()) * SIMULATION_TIME_SCALE;
+        ubo.substeps = batch.substeps;
 
-        memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        memcpy(uniformBuffersMapped[slot], &ubo, sizeof(ubo));
     }
 
     /**
-     * The method initiates computation on the GPU using a compute shader, updates uniform buffers to transfer
-     * data to the GPU, and submits the compute command buffer. It then synchronizes the application to ensure
-     * image availability, acquires the next image from the swap chain, and records commands for rendering.
-     * Upon completion of these steps, it submits the rendering command buffer to the graphics queue for execution.
-     * Lastly, it presents the final image to the screen via the swap chain and manages synchronization primitives
-     * and swap chain status to maintain smooth rendering of consecutive frames.
+     * Records and submits simulation batch 'step' to the compute queue, with
+     * the fixed steps the clock has due. It waits for the batch that last used
+     * the state slot, normally long finished, and signals the semaphore of the
+     * previous state once it has been read, see recordComputeCommandBuffer().
+     * The first batch also waits for the initial state when that was written on
+     * another queue family.
      */
-    void drawFrame()
+    void submitSimulationStep(uint64_t step)
     {
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        uint32_t slot = static_cast<uint32_t>(step % simulationSlots());
 
-        /*
-         * Compute submission
-         */
-        vkWaitForFences(device, 1, &computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        vkWaitForFences(device, 1, &computeInFlightFences[slot], VK_TRUE, UINT64_MAX);
+        profiler.mark(FramePhase::FenceWait);
+
+        SimulationBatch batch = simulationClock.takeBatch();
+        updateUniformBuffer(slot, batch);
+        stateAlphas[slot] = batch.alpha;
 
-        updateUniformBuffer(currentFrame);
+        vkResetFences(device, 1, &computeInFlightFences[slot]);
 
-        vkResetFences(device, 1, &computeInFlightFences[currentFrame]);
+        vkResetCommandBuffer(computeCommandBuffers[slot], /*VkCommandBufferResetFlagBits*/ 0);
+        recordComputeCommandBuffer(computeCommandBuffers[slot], step);
+        profiler.mark(FramePhase::Record);
 
-        vkResetCommandBuffer(computeCommandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-        recordComputeCommandBuffer(computeCommandBuffers[currentFrame]);
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        if (step == 1 && particleInitSemaphore != VK_NULL_HANDLE)
+        {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &particleInitSemaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
+        submitInfo.pCommandBuffers = &computeCommandBuffers[slot];
         submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+        submitInfo.pSignalSemaphores = &stateReadySemaphores[(step - 1) % simulationSlots()];
 
-        if (vkQueueSubmit(computeQueue, 1, &submitInfo, computeInFlightFences[currentFrame]) != VK_SUCCESS)
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, computeInFlightFences[slot]) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to submit compute command buffer!");
-        };
+        }
+        profiler.mark(FramePhase::Submit);
+    }
+
+    /**
+     * Draws one frame while the compute queue runs ahead. The frame draws state
+     * drawnState, and the simulation is first topped up to --simulation-lead
+     * batches past it. Each batch runs as many fixed steps as the frame time
+     * added to simulationClock. Drawing a state waits only for the step after it, which
+     * releases it, so the steps queued behind that one run on the compute
+     * queue while the graphics queue renders. Without a compute-only family
+     * both share one queue, and the schedule merely keeps the CPU from waiting.
+     *
+     * Waiting for this frame slot's fence first also frees the state the frame
+     * MAX_FRAMES_IN_FLIGHT frames ago drew, which is the slot the newest step
+     * overwrites. The rest of the frame acquires the next image from the swap
+     * chain, records and submits the rendering command buffer, and presents.
+     */
+    void drawFrame()
+    {
+        if (gpuTimer)
+        {
+            gpuTimer->nextFrame();
+        }
 
         /*
          * Wait for the fences to be signaled before proceeding.
-         * Acquire the next image from the swap chain.
-         * If swap chain is out of date, recreate it and return.
-         * If acquiring the swap chain image fails, throw an exception.
-         * Reset the fence for next frame.
          */
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        profiler.mark(FramePhase::FenceWait);
 
-        uint32_t imageIndex;
         /*
-         * Acquire next image from swap chain
+         * Compute submissions, more than one only on the first frame
          */
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        while (simulatedState < drawnState + options.simulationLead)
+        {
+            simulatedState++;
+            submitSimulationStep(simulatedState);
+        }
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        /*
+         * Acquire the next image from the swap chain.
+         * If swap chain is out of date, recreate it and return.
+         * If acquiring the swap chain image fails, throw an exception.
+         * Reset the fence for next frame.
+         */
+        uint32_t imageIndex;
+        if (options.headless)
         {
-            recreateSwapChain();
-            return;
+            /* The offscreen image of this frame slot was released by the fence above */
+            imageIndex = currentFrame;
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        else
         {
-            throw std::runtime_error("failed to acquire swap chain image!");
+            /*
+             * Acquire next image from swap chain
+             */
+            VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreateSwapChain();
+                return;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
 
+        profiler.mark(FramePhase::Acquire);
+
         vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
         /*
          * Record command buffer, first reset command buffer.
          */
         vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex, drawnState);
+        profiler.mark(FramePhase::Record);
 
         /*
          * Sets up semaphores and pipeline stages for Vulkan to synchronize computations and image availability,
+         * headless frames only wait for the computations and present nothing
          */
-        VkSemaphore waitSemaphores[] = {computeFinishedSemaphores[currentFrame], imageAvailableSemaphores[currentFrame]};
+        VkSemaphore waitSemaphores[] = {stateReadySemaphores[drawnState % simulationSlots()], imageAvailableSemaphores[currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
         /*
          * Submit command buffer
          */
-        submitInfo = {};
+        VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        submitInfo.waitSemaphoreCount = 2;
+        submitInfo.waitSemaphoreCount = options.headless ? 1 : 2;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pSignalSemaphores = &renderFinishedSemaphores[currentFrame];
 
         if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        drawnState++;
+        profiler.mark(FramePhase::Submit);
+
+        if (options.headless)
+        {
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return;
+        }
 
         /*
          * Presentation - submitting result back to swap chain to show up on screen
@@ -1860,7 +2784,8 @@ private:
 
         presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        profiler.mark(FramePhase::Present);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
         {
@@ -1876,23 +2801,23 @@ private:
     }
 
     /**
-     * Create a Vulkan shader module from the provided code.
+     * Create a Vulkan shader module from an embedded shader.
      *
-     * @param code A vector containing the binary code of the shader.
+     * @param shader The SPIR-V of the shader, see findShader().
      * @return A Vulkan shader module.
      * @throws std::runtime_error if the shader module creation fails.
      */
-    VkShaderModule createShaderModule(const std::vector<char> &code)
+    VkShaderModule createShaderModule(const ShaderBinary &shader)
     {
         /*
          * The sType member is set to indicate the type of structure, VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO.
-         * The codeSize member is assigned the size of the code vector, while the pCode member is assigned a
-         * reinterpretation of the code vector as a pointer to an array of const uint32_t.
+         * The codeSize member is assigned the size of the SPIR-V in bytes, while the pCode member points
+         * straight at the embedded array of uint32_t words.
          */
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        createInfo.codeSize = shader.size;
+        createInfo.pCode = shader.code;
 
         VkShaderModule shaderModule;
         if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
@@ -2025,8 +2950,9 @@ private:
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported)
+        /* Headless runs render into images of their own */
+        bool swapChainAdequate = options.headless;
+        if (extensionsSupported && !options.headless)
         {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -2049,7 +2975,8 @@ private:
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char *> extensions = requiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto &extension : availableExtensions)
         {
@@ -2059,6 +2986,15 @@ private:
         return requiredExtensions.empty();
     }
 
+    /**
+     * @return The device extensions to enable: the swap chain extension, or none
+     * when headless.
+     */
+    std::vector<const char *> requiredDeviceExtensions()
+    {
+        return options.headless ? std::vector<const char *>() : deviceExtensions;
+    }
+
     /**
      * Checks which queue families are supported by the device and which one of these supports the commands that we
      * want to use.
@@ -2087,8 +3023,19 @@ private:
                 indices.graphicsAndComputeFamily = i;
             }
 
+            /*
+             * Headless runs present nothing, so the graphics and compute family
+             * stands in for the present family
+             */
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (options.headless)
+            {
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
 
             if (presentSupport)
             {
@@ -2103,6 +3050,21 @@ private:
             i++;
         }
 
+        /*
+         * The simulation prefers a family that can compute but not draw, which
+         * usually maps to asynchronous compute hardware that runs alongside the
+         * graphics queue
+         */
+        for (uint32_t j = 0; j < queueFamilyCount && options.asyncCompute; j++)
+        {
+            VkQueueFlags flags = queueFamilies[j].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                indices.computeFamily = j;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -2113,11 +3075,19 @@ private:
      */
     std::vector<const char *> getRequiredExtensions()
     {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char *> extensions;
 
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        /*
+         * Window system extensions are only needed to create the surface
+         */
+        if (!options.headless)
+        {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         /*
          * VK_EXT_DEBUG_UTILS_EXTENSION_NAME macro here which is equal to the literal string "VK_EXT_debug_utils".
@@ -2171,44 +3141,6 @@ private:
         return true;
     }
 
-    /**
-     * Read the contents of a file and return them as a vector of characters.
-     *
-     * @param filename The name of the file to read.
-     * @return A vector containing the characters read from the file.
-     * @throws std::runtime_error if the file fails to open.
-     */
-    static std::vector<char> readFile(const std::string &filename)
-    {
-        /*
-         * Open the file in binary mode, starting at the end
-         * to determine the file size.
-         */
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open())
-        {
-            throw std::runtime_error("failed to open file!");
-        }
-
-        /*
-         * Determine the file size and allocate a buffer accordingly.
-         */
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        /*
-         * Move the file pointer to the beginning and read
-         * the file contents into the buffer.
-         */
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
-        return buffer;
-    }
-
     /**
      * The VKAPI_ATTR and VKAPI_CALL ensure that the function has the right signature for Vulkan to call it.
      *
@@ -2239,16 +3171,190 @@ private:
     }
 };
 
+/**
+ * Parses the command line.
+ *
+ *      --headless          Render offscreen, without a window (for CI and render farm nodes)
+ *      --width N           Window or offscreen image width in pixels (default 800)
+ *      --height N          Window or offscreen image height in pixels (default 600)
+ *      --frames N          Exit after N frames (headless default 100, windowed default: when closed)
+ *      --benchmark M       Measure M frames after the warm-up and report CPU frame and drawFrame() phase times
+ *      --warmup N          Frames to run before measuring (default 60)
+ *      --benchmark-json F  Where to write the benchmark report as JSON (default benchmark.json)
+ *      --gpu-timestamps F  Time render pass and compute dispatch on the GPU, per frame into CSV file F, summary at exit
+ *      --frame-stats F     Count recorded commands and pipeline statistics, per frame into CSV file F, summary at exit
+ *      --startup-report    Print wall and CPU time per initialization stage
+ *      --startup-json F    Also write the startup report as JSON to file F
+ *      --exit-after-init   Exit after initialization, for timing cold and warm starts
+ *      --pipeline-cache F  Load and save compiled pipelines in file F (default compute_pipeline_cache.bin)
+ *      --no-pipeline-cache Compile all pipelines from scratch and don't save them
+ *      --pipeline-threads N Threads compiling pipelines in the background (default 1, 0 = inside initVulkan())
+ *      --particles N       Number of particles to simulate (default 8192)
+ *      --seed N            Seed of the initial particles, for reproducible runs (default: from the clock)
+ *      --simulation-lead N Simulation steps queued ahead of the drawn state (default 1)
+ *      --no-async-compute  Simulate on the graphics queue even if the device has a compute-only queue family
+ *      --sim-rate HZ       Fixed simulation steps per second, independent of the frame rate (default 120)
+ *      --max-substeps N    Most steps one frame may catch up on after a hitch, the rest is dropped (default 8)
+ *
+ * @return The parsed options.
+ */
+/**
+ * Parses the value of a numeric command line option.
+ *
+ * @param value Text of the value.
+ * @param what Name of the value in the error message.
+ * @return The parsed value, if it fits in 32 bits.
+ */
+uint32_t parseUint32(const std::string &value, const std::string &what)
+{
+    unsigned long long parsed = std::stoull(value);
+    if (parsed > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::runtime_error(what + " must not exceed " + std::to_string(std::numeric_limits<uint32_t>::max()) + "!");
+    }
+    return static_cast<uint32_t>(parsed);
+}
+
+ApplicationOptions parseOptions(int argc, char **argv)
+{
+    ApplicationOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--height" && i + 1 < argc)
+        {
+            options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            options.benchmarkFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            options.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark-json" && i + 1 < argc)
+        {
+            options.benchmarkJson = argv[++i];
+        }
+        else if (arg == "--gpu-timestamps" && i + 1 < argc)
+        {
+            options.gpuTimestamps = argv[++i];
+        }
+        else if (arg == "--frame-stats" && i + 1 < argc)
+        {
+            options.frameStatistics = argv[++i];
+        }
+        else if (arg == "--startup-report")
+        {
+            options.startupReport = true;
+        }
+        else if (arg == "--startup-json" && i + 1 < argc)
+        {
+            options.startupReport = true;
+            options.startupJson = argv[++i];
+        }
+        else if (arg == "--exit-after-init")
+        {
+            options.exitAfterInit = true;
+        }
+        else if (arg == "--pipeline-cache" && i + 1 < argc)
+        {
+            options.pipelineCache = argv[++i];
+        }
+        else if (arg == "--no-pipeline-cache")
+        {
+            options.pipelineCache.clear();
+        }
+        else if (arg == "--pipeline-threads" && i + 1 < argc)
+        {
+            options.pipelineThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--particles" && i + 1 < argc)
+        {
+            options.particleCount = parseUint32(argv[++i], "particle count");
+            if (options.particleCount == 0)
+            {
+                throw std::runtime_error("particle count must be at least 1!");
+            }
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            options.seed = parseUint32(argv[++i], "seed");
+        }
+        else if (arg == "--simulation-lead" && i + 1 < argc)
+        {
+            options.simulationLead = parseUint32(argv[++i], "simulation lead");
+            if (options.simulationLead == 0)
+            {
+                throw std::runtime_error("simulation lead must be at least 1 step!");
+            }
+        }
+        else if (arg == "--no-async-compute")
+        {
+            options.asyncCompute = false;
+        }
+        else if (arg == "--sim-rate" && i + 1 < argc)
+        {
+            options.simulationRate = std::stod(argv[++i]);
+            if (!(options.simulationRate > 0.0))
+            {
+                throw std::runtime_error("simulation rate must be positive!");
+            }
+        }
+        else if (arg == "--max-substeps" && i + 1 < argc)
+        {
+            options.maxSubsteps = parseUint32(argv[++i], "max substeps");
+            if (options.maxSubsteps == 0)
+            {
+                throw std::runtime_error("max substeps must be at least 1!");
+            }
+        }
+        else
+        {
+            throw std::runtime_error("unknown option " + arg + "!");
+        }
+    }
+
+    if (options.width == 0 || options.height == 0)
+    {
+        throw std::runtime_error("width and height must be at least 1 pixel!");
+    }
+    if (options.benchmarkFrames > 0)
+    {
+        options.frames = options.warmupFrames + options.benchmarkFrames;
+    }
+    if (options.headless && options.frames == 0)
+    {
+        options.frames = HEADLESS_DEFAULT_FRAMES;
+    }
+
+    return options;
+}
+
 /**
  * Main code that is compiled and run
  * @return exit code
  */
-int main()
+int main(int argc, char **argv)
 {
-    ComputeShaderApplication app;
-
     try
     {
+        ComputeShaderApplication app(parseOptions(argc, argv));
         app.run();
     }
     catch (const std::exception &e)
@@ -0,0 +1,806 @@
+/**
+ * Device memory sub-allocator.
+ *
+ * Calling vkAllocateMemory once per buffer or image quickly runs into
+ * maxMemoryAllocationCount and costs a kernel round-trip per resource. The
+ * allocator instead reserves large blocks per memory type and places resources
+ * inside them with a TLSF (two-level segregated fit) allocator, which finds a
+ * fitting free range and coalesces neighbours on free in constant time.
+ *
+ *      - Alignment from VkMemoryRequirements is honoured per allocation.
+ *      - bufferImageGranularity: linear resources (buffers, linear images) and
+ *        optimal-tiling images are kept in separate blocks whenever the device
+ *        granularity is larger than 1, so they can never share a page.
+ *      - Resources larger than half a block get a dedicated vkAllocateMemory.
+ *      - Host-visible blocks are mapped once; DeviceAllocation::mapped points
+ *        straight at the resource.
+ *      - Freed ranges go back to the free lists; one empty block per pool is kept
+ *        around so alternating create/destroy does not hit the driver.
+ *
+ * The actual memory calls go through DeviceMemoryBackend so the allocator can be
+ * driven by MockMemoryBackend without a GPU.
+ */
+#ifndef DEVICE_ALLOCATOR_H
+#define DEVICE_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Interface to the memory calls the allocator needs.
+ */
+class DeviceMemoryBackend
+{
+public:
+    virtual ~DeviceMemoryBackend() = default;
+
+    virtual VkResult allocate(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory *memory) = 0;
+    virtual void free(VkDeviceMemory memory) = 0;
+    virtual VkResult map(VkDeviceMemory memory, VkDeviceSize size, void **data) = 0;
+    virtual void unmap(VkDeviceMemory memory) = 0;
+};
+
+/**
+ * Backend forwarding to the Vulkan device.
+ */
+class VulkanMemoryBackend : public DeviceMemoryBackend
+{
+public:
+    explicit VulkanMemoryBackend(VkDevice device) : device(device)
+    {
+    }
+
+    VkResult allocate(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory *memory) override
+    {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        return vkAllocateMemory(device, &allocInfo, nullptr, memory);
+    }
+
+    void free(VkDeviceMemory memory) override
+    {
+        vkFreeMemory(device, memory, nullptr);
+    }
+
+    VkResult map(VkDeviceMemory memory, VkDeviceSize size, void **data) override
+    {
+        return vkMapMemory(device, memory, 0, size, 0, data);
+    }
+
+    void unmap(VkDeviceMemory memory) override
+    {
+        vkUnmapMemory(device, memory);
+    }
+
+private:
+    VkDevice device;
+};
+
+/**
+ * Host memory backend for exercising the allocator without a GPU. Handles are
+ * fake, mapped memory is real host memory (allocated on first map). An optional
+ * budget makes allocations fail with VK_ERROR_OUT_OF_DEVICE_MEMORY once exceeded.
+ */
+class MockMemoryBackend : public DeviceMemoryBackend
+{
+public:
+    explicit MockMemoryBackend(VkDeviceSize budget = ~VkDeviceSize(0)) : budget(budget)
+    {
+    }
+
+    VkResult allocate(uint32_t, VkDeviceSize size, VkDeviceMemory *memory) override
+    {
+        if (bytesAllocated + size > budget)
+        {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+
+        uint64_t id = nextId++;
+        *memory = (VkDeviceMemory)(uintptr_t)id;
+        allocations[id].size = size;
+        bytesAllocated += size;
+        allocationCount++;
+        totalAllocateCalls++;
+        return VK_SUCCESS;
+    }
+
+    void free(VkDeviceMemory memory) override
+    {
+        auto it = allocations.find((uint64_t)(uintptr_t)memory);
+        if (it == allocations.end())
+        {
+            throw std::runtime_error("mock backend: freeing unknown memory!");
+        }
+        bytesAllocated -= it->second.size;
+        allocationCount--;
+        allocations.erase(it);
+    }
+
+    VkResult map(VkDeviceMemory memory, VkDeviceSize size, void **data) override
+    {
+        auto &allocation = allocations.at((uint64_t)(uintptr_t)memory);
+        allocation.hostCopy.resize(static_cast<size_t>(size));
+        *data = allocation.hostCopy.data();
+        return VK_SUCCESS;
+    }
+
+    void unmap(VkDeviceMemory memory) override
+    {
+        allocations.at((uint64_t)(uintptr_t)memory).hostCopy.clear();
+    }
+
+    VkDeviceSize bytesAllocated = 0;
+    uint32_t allocationCount = 0;    // live vkAllocateMemory equivalents
+    uint32_t totalAllocateCalls = 0; // including freed ones
+
+private:
+    struct Allocation
+    {
+        VkDeviceSize size = 0;
+        std::vector<char> hostCopy;
+    };
+
+    VkDeviceSize budget;
+    uint64_t nextId = 1;
+    std::unordered_map<uint64_t, Allocation> allocations;
+};
+
+/**
+ * How a resource is laid out in memory, relevant for bufferImageGranularity.
+ */
+enum class DeviceResourceKind
+{
+    Linear,   // buffers and VK_IMAGE_TILING_LINEAR images
+    Optimal   // VK_IMAGE_TILING_OPTIMAL images
+};
+
+class DeviceMemoryBlock;
+
+/**
+ * A placed resource. 'memory' and 'offset' are what vkBind*Memory needs.
+ */
+struct DeviceAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr; // Host pointer to the resource if the memory type is host visible
+
+    DeviceMemoryBlock *block = nullptr; // nullptr for dedicated allocations
+    uint32_t node = 0;
+    uint32_t pool = 0;
+};
+
+/**
+ * Allocator statistics.
+ */
+struct DeviceAllocatorStats
+{
+    uint32_t blockCount = 0;
+    uint32_t dedicatedAllocationCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize bytesReserved = 0;    // device memory obtained from the driver
+    VkDeviceSize bytesUsed = 0;        // sum of requested resource sizes
+    VkDeviceSize bytesWasted = 0;      // alignment padding and slivers too small to track
+    VkDeviceSize bytesFree = 0;        // free ranges inside blocks
+    VkDeviceSize largestFreeRange = 0;
+    double fragmentation = 0.0;        // 1 - sum of per-block largest free ranges / free bytes
+};
+
+/**
+ * One vkAllocateMemory managed with TLSF.
+ *
+ * Free ranges are kept in FL_COUNT x SL_COUNT segregated lists: the first level
+ * is the power of two of the size, the second level splits that range linearly
+ * in SL_COUNT steps. Two bitmaps record which lists are non-empty, so finding a
+ * list whose ranges are all large enough is a couple of bit scans.
+ */
+class DeviceMemoryBlock
+{
+public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    DeviceMemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void *mapped)
+        : memory(memory), size(size), mapped(mapped), freeBytes(size)
+    {
+        std::fill(&freeHeads[0][0], &freeHeads[0][0] + FL_COUNT * SL_COUNT, NIL);
+        uint32_t node = createNode(0, size);
+        insertFree(node);
+    }
+
+    /**
+     * Places 'requestSize' bytes at an 'alignment' boundary.
+     *
+     * @param offset Receives the aligned offset.
+     * @return The node identifying the range, or NIL if the block has no room.
+     */
+    uint32_t allocate(VkDeviceSize requestSize, VkDeviceSize alignment, VkDeviceSize &offset)
+    {
+        VkDeviceSize searchSize = requestSize + (alignment > 1 ? alignment - 1 : 0);
+        uint32_t node = findFree(searchSize);
+        if (node == NIL)
+        {
+            return NIL;
+        }
+        removeFree(node);
+
+        /*
+         * Split off the alignment padding in front and the unused tail as separate
+         * free ranges unless they are too small to be worth tracking, in which case
+         * they stay with the allocation and count as waste.
+         */
+        VkDeviceSize alignedOffset = (nodes[node].offset + alignment - 1) / alignment * alignment;
+        VkDeviceSize padding = alignedOffset - nodes[node].offset;
+        if (padding >= MIN_FREE_RANGE)
+        {
+            uint32_t front = splitFront(node, padding);
+            insertFree(front);
+        }
+
+        VkDeviceSize usedSize = alignedOffset + requestSize - nodes[node].offset;
+        if (nodes[node].size - usedSize >= MIN_FREE_RANGE)
+        {
+            uint32_t tail = splitBack(node, usedSize);
+            insertFree(tail);
+        }
+
+        nodes[node].requested = requestSize;
+        freeBytes -= nodes[node].size;
+        allocationCount++;
+        offset = alignedOffset;
+        return node;
+    }
+
+    /**
+     * Returns a range to the free lists, merging it with free neighbours.
+     */
+    void free(uint32_t node)
+    {
+        freeBytes += nodes[node].size;
+        allocationCount--;
+        nodes[node].requested = 0;
+
+        uint32_t prev = nodes[node].prevPhys;
+        if (prev != NIL && nodes[prev].isFree)
+        {
+            removeFree(prev);
+            node = merge(prev, node);
+        }
+        uint32_t next = nodes[node].nextPhys;
+        if (next != NIL && nodes[next].isFree)
+        {
+            removeFree(next);
+            node = merge(node, next);
+        }
+        insertFree(node);
+    }
+
+    /**
+     * Adds this block's numbers to 'stats'.
+     *
+     * @return The largest free range in this block.
+     */
+    VkDeviceSize accumulateStats(DeviceAllocatorStats &stats) const
+    {
+        VkDeviceSize largestFree = 0;
+        stats.blockCount++;
+        stats.allocationCount += allocationCount;
+        stats.bytesReserved += size;
+        stats.bytesFree += freeBytes;
+        for (const Node &node : nodes)
+        {
+            if (node.isFree)
+            {
+                largestFree = std::max(largestFree, node.size);
+            }
+            else if (node.requested > 0)
+            {
+                stats.bytesUsed += node.requested;
+                stats.bytesWasted += node.size - node.requested;
+            }
+        }
+        stats.largestFreeRange = std::max(stats.largestFreeRange, largestFree);
+        return largestFree;
+    }
+
+    bool empty() const
+    {
+        return allocationCount == 0;
+    }
+
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void *mapped;
+
+private:
+    static constexpr uint32_t SL_BITS = 4;
+    static constexpr uint32_t SL_COUNT = 1 << SL_BITS;
+    static constexpr uint32_t FL_SMALL_BITS = 8; // sizes below 256 bytes share first level 0
+    static constexpr uint32_t FL_COUNT = 64 - FL_SMALL_BITS + 1;
+    static constexpr VkDeviceSize MIN_FREE_RANGE = 64;
+
+    struct Node
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        VkDeviceSize requested;
+        uint32_t prevPhys;
+        uint32_t nextPhys;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool isFree;
+        bool alive;
+    };
+
+    static uint32_t log2Floor(VkDeviceSize value)
+    {
+        uint32_t result = 0;
+        while (value >>= 1)
+        {
+            result++;
+        }
+        return result;
+    }
+
+    static uint32_t countTrailingZeros(uint64_t value)
+    {
+        uint32_t result = 0;
+        while ((value & 1) == 0)
+        {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    /*
+     * List that ranges of exactly 'rangeSize' bytes are stored in.
+     */
+    static void mapping(VkDeviceSize rangeSize, uint32_t &fl, uint32_t &sl)
+    {
+        if (rangeSize < (VkDeviceSize(1) << FL_SMALL_BITS))
+        {
+            fl = 0;
+            sl = static_cast<uint32_t>(rangeSize >> (FL_SMALL_BITS - SL_BITS));
+            return;
+        }
+
+        uint32_t msb = log2Floor(rangeSize);
+        fl = msb - FL_SMALL_BITS + 1;
+        sl = static_cast<uint32_t>(rangeSize >> (msb - SL_BITS)) ^ SL_COUNT;
+    }
+
+    /*
+     * First free range of at least 'rangeSize' bytes. The size is rounded up to the
+     * next list boundary so that every range in the selected list fits.
+     */
+    uint32_t findFree(VkDeviceSize rangeSize) const
+    {
+        if (rangeSize >= (VkDeviceSize(1) << FL_SMALL_BITS))
+        {
+            rangeSize += (VkDeviceSize(1) << (log2Floor(rangeSize) - SL_BITS)) - 1;
+        }
+        else
+        {
+            rangeSize += (VkDeviceSize(1) << (FL_SMALL_BITS - SL_BITS)) - 1;
+        }
+
+        uint32_t fl, sl;
+        mapping(rangeSize, fl, sl);
+        if (fl >= FL_COUNT)
+        {
+            return NIL;
+        }
+
+        uint32_t slMap = sl < SL_COUNT ? secondLevelMap[fl] & (~0u << sl) : 0;
+        if (slMap == 0)
+        {
+            uint64_t flMap = fl + 1 < 64 ? firstLevelMap & (~uint64_t(0) << (fl + 1)) : 0;
+            if (flMap == 0)
+            {
+                return NIL;
+            }
+            fl = countTrailingZeros(flMap);
+            slMap = secondLevelMap[fl];
+        }
+        sl = countTrailingZeros(slMap);
+        return freeHeads[fl][sl];
+    }
+
+    void insertFree(uint32_t node)
+    {
+        uint32_t fl, sl;
+        mapping(nodes[node].size, fl, sl);
+
+        nodes[node].isFree = true;
+        nodes[node].prevFree = NIL;
+        nodes[node].nextFree = freeHeads[fl][sl];
+        if (freeHeads[fl][sl] != NIL)
+        {
+            nodes[freeHeads[fl][sl]].prevFree = node;
+        }
+        freeHeads[fl][sl] = node;
+        firstLevelMap |= uint64_t(1) << fl;
+        secondLevelMap[fl] |= 1u << sl;
+    }
+
+    void removeFree(uint32_t node)
+    {
+        uint32_t fl, sl;
+        mapping(nodes[node].size, fl, sl);
+
+        Node &n = nodes[node];
+        if (n.prevFree != NIL)
+        {
+            nodes[n.prevFree].nextFree = n.nextFree;
+        }
+        else
+        {
+            freeHeads[fl][sl] = n.nextFree;
+        }
+        if (n.nextFree != NIL)
+        {
+            nodes[n.nextFree].prevFree = n.prevFree;
+        }
+        if (freeHeads[fl][sl] == NIL)
+        {
+            secondLevelMap[fl] &= ~(1u << sl);
+            if (secondLevelMap[fl] == 0)
+            {
+                firstLevelMap &= ~(uint64_t(1) << fl);
+            }
+        }
+        n.isFree = false;
+    }
+
+    uint32_t createNode(VkDeviceSize offset, VkDeviceSize nodeSize)
+    {
+        uint32_t index;
+        if (!unusedNodes.empty())
+        {
+            index = unusedNodes.back();
+            unusedNodes.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[index] = Node{offset, nodeSize, 0, NIL, NIL, NIL, NIL, false, true};
+        return index;
+    }
+
+    /*
+     * Splits 'frontSize' bytes off the start of 'node' into a new node placed before it.
+     */
+    uint32_t splitFront(uint32_t node, VkDeviceSize frontSize)
+    {
+        uint32_t front = createNode(nodes[node].offset, frontSize);
+        nodes[front].prevPhys = nodes[node].prevPhys;
+        nodes[front].nextPhys = node;
+        if (nodes[node].prevPhys != NIL)
+        {
+            nodes[nodes[node].prevPhys].nextPhys = front;
+        }
+        nodes[node].prevPhys = front;
+        nodes[node].offset += frontSize;
+        nodes[node].size -= frontSize;
+        return front;
+    }
+
+    /*
+     * Keeps 'keepSize' bytes in 'node' and moves the rest into a new node after it.
+     */
+    uint32_t splitBack(uint32_t node, VkDeviceSize keepSize)
+    {
+        uint32_t back = createNode(nodes[node].offset + keepSize, nodes[node].size - keepSize);
+        nodes[back].prevPhys = node;
+        nodes[back].nextPhys = nodes[node].nextPhys;
+        if (nodes[node].nextPhys != NIL)
+        {
+            nodes[nodes[node].nextPhys].prevPhys = back;
+        }
+        nodes[node].nextPhys = back;
+        nodes[node].size = keepSize;
+        return back;
+    }
+
+    /*
+     * Merges physically adjacent 'second' into 'first'.
+     */
+    uint32_t merge(uint32_t first, uint32_t second)
+    {
+        nodes[first].size += nodes[second].size;
+        nodes[first].nextPhys = nodes[second].nextPhys;
+        if (nodes[second].nextPhys != NIL)
+        {
+            nodes[nodes[second].nextPhys].prevPhys = first;
+        }
+        nodes[second].alive = false;
+        nodes[second].isFree = false;
+        nodes[second].requested = 0;
+        unusedNodes.push_back(second);
+        return first;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint64_t firstLevelMap = 0;
+    uint32_t secondLevelMap[FL_COUNT] = {};
+    uint32_t freeHeads[FL_COUNT][SL_COUNT];
+    VkDeviceSize freeBytes;
+    uint32_t allocationCount = 0;
+};
+
+/**
+ * Pools of DeviceMemoryBlock per memory type and resource kind.
+ */
+class DeviceAllocator
+{
+public:
+    /*
+     * Default size of a memory block
+     */
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    /**
+     * @param backend Memory backend, must outlive the allocator.
+     * @param memoryProperties Memory types of the physical device.
+     * @param bufferImageGranularity VkPhysicalDeviceLimits::bufferImageGranularity.
+     * @param blockSize Size of the blocks reserved per pool.
+     */
+    DeviceAllocator(DeviceMemoryBackend &backend, const VkPhysicalDeviceMemoryProperties &memoryProperties,
+                    VkDeviceSize bufferImageGranularity, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE)
+        : backend(backend), memoryProperties(memoryProperties), bufferImageGranularity(bufferImageGranularity),
+          blockSize(blockSize), pools(memoryProperties.memoryTypeCount * 2)
+    {
+    }
+
+    ~DeviceAllocator()
+    {
+        for (auto &pool : pools)
+        {
+            for (auto &block : pool)
+            {
+                releaseBlock(*block);
+            }
+        }
+        for (auto &dedicated : dedicatedAllocations)
+        {
+            if (dedicated.second)
+            {
+                backend.unmap(dedicated.first);
+            }
+            backend.free(dedicated.first);
+        }
+    }
+
+    DeviceAllocator(const DeviceAllocator &) = delete;
+    DeviceAllocator &operator=(const DeviceAllocator &) = delete;
+
+    /**
+     * Allocates memory for a resource.
+     *
+     * @param requirements Requirements from vkGet*MemoryRequirements.
+     * @param memoryTypeIndex Memory type to allocate from (see findMemoryType()).
+     * @param kind Whether the resource is linear or an optimal-tiling image.
+     * @return The allocation; throws if the memory cannot be provided.
+     */
+    DeviceAllocation allocate(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, DeviceResourceKind kind)
+    {
+        if (memoryTypeIndex >= memoryProperties.memoryTypeCount)
+        {
+            throw std::runtime_error("invalid memory type index!");
+        }
+
+        if (requirements.size > blockSize / 2)
+        {
+            return allocateDedicated(requirements.size, memoryTypeIndex);
+        }
+
+        /*
+         * Linear and optimal resources only need separate pools when the device
+         * imposes a granularity between them.
+         */
+        uint32_t poolIndex = memoryTypeIndex * 2;
+        if (kind == DeviceResourceKind::Optimal && bufferImageGranularity > 1)
+        {
+            poolIndex++;
+        }
+        auto &pool = pools[poolIndex];
+
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        for (auto &block : pool)
+        {
+            DeviceAllocation allocation;
+            if (placeInBlock(*block, requirements.size, alignment, poolIndex, allocation))
+            {
+                return allocation;
+            }
+        }
+
+        VkDeviceMemory memory;
+        if (backend.allocate(memoryTypeIndex, blockSize, &memory) != VK_SUCCESS)
+        {
+            /*
+             * Out of memory for a whole block: try to get just what is needed.
+             */
+            return allocateDedicated(requirements.size, memoryTypeIndex);
+        }
+
+        void *mapped = nullptr;
+        if (isHostVisible(memoryTypeIndex) && backend.map(memory, blockSize, &mapped) != VK_SUCCESS)
+        {
+            backend.free(memory);
+            throw std::runtime_error("failed to map device memory block!");
+        }
+
+        pool.push_back(std::unique_ptr<DeviceMemoryBlock>(new DeviceMemoryBlock(memory, blockSize, mapped)));
+
+        DeviceAllocation allocation;
+        if (!placeInBlock(*pool.back(), requirements.size, alignment, poolIndex, allocation))
+        {
+            throw std::runtime_error("failed to place allocation in a new memory block!");
+        }
+        return allocation;
+    }
+
+    /**
+     * Frees an allocation. Freeing a default-constructed allocation is a no-op.
+     */
+    void free(DeviceAllocation &allocation)
+    {
+        if (allocation.memory == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        if (allocation.block == nullptr)
+        {
+            auto it = std::find_if(dedicatedAllocations.begin(), dedicatedAllocations.end(),
+                                   [&](const std::pair<VkDeviceMemory, bool> &entry)
+                                   { return entry.first == allocation.memory; });
+            if (it == dedicatedAllocations.end())
+            {
+                throw std::runtime_error("freeing unknown device allocation!");
+            }
+            if (it->second)
+            {
+                backend.unmap(it->first);
+            }
+            backend.free(it->first);
+            dedicatedBytes -= allocation.size;
+            dedicatedAllocations.erase(it);
+        }
+        else
+        {
+            DeviceMemoryBlock *block = allocation.block;
+            block->free(allocation.node);
+
+            /*
+             * Keep one empty block per pool for reuse, release any further ones.
+             */
+            if (block->empty())
+            {
+                auto &pool = pools[allocation.pool];
+                size_t emptyBlocks = std::count_if(pool.begin(), pool.end(),
+                                                   [](const std::unique_ptr<DeviceMemoryBlock> &b)
+                                                   { return b->empty(); });
+                if (emptyBlocks > 1)
+                {
+                    auto it = std::find_if(pool.begin(), pool.end(),
+                                           [block](const std::unique_ptr<DeviceMemoryBlock> &b)
+                                           { return b.get() == block; });
+                    releaseBlock(*block);
+                    pool.erase(it);
+                }
+            }
+        }
+
+        allocation = DeviceAllocation{};
+    }
+
+    /**
+     * Gathers statistics over all blocks and dedicated allocations.
+     */
+    DeviceAllocatorStats stats() const
+    {
+        DeviceAllocatorStats result;
+        VkDeviceSize largestFreeSum = 0;
+        for (const auto &pool : pools)
+        {
+            for (const auto &block : pool)
+            {
+                largestFreeSum += block->accumulateStats(result);
+            }
+        }
+
+        result.dedicatedAllocationCount = static_cast<uint32_t>(dedicatedAllocations.size());
+        result.allocationCount += result.dedicatedAllocationCount;
+        result.bytesReserved += dedicatedBytes;
+        result.bytesUsed += dedicatedBytes;
+        result.fragmentation = result.bytesFree > 0
+                                   ? 1.0 - static_cast<double>(largestFreeSum) / result.bytesFree
+                                   : 0.0;
+        return result;
+    }
+
+private:
+    bool isHostVisible(uint32_t memoryTypeIndex) const
+    {
+        return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    bool placeInBlock(DeviceMemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, uint32_t poolIndex, DeviceAllocation &allocation)
+    {
+        VkDeviceSize offset;
+        uint32_t node = block.allocate(size, alignment, offset);
+        if (node == DeviceMemoryBlock::NIL)
+        {
+            return false;
+        }
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char *>(block.mapped) + offset : nullptr;
+        allocation.block = &block;
+        allocation.node = node;
+        allocation.pool = poolIndex;
+        return true;
+    }
+
+    DeviceAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex)
+    {
+        DeviceAllocation allocation;
+        if (backend.allocate(memoryTypeIndex, size, &allocation.memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+
+        bool mapped = false;
+        if (isHostVisible(memoryTypeIndex))
+        {
+            if (backend.map(allocation.memory, size, &allocation.mapped) != VK_SUCCESS)
+            {
+                backend.free(allocation.memory);
+                throw std::runtime_error("failed to map device memory!");
+            }
+            mapped = true;
+        }
+
+        allocation.size = size;
+        dedicatedAllocations.emplace_back(allocation.memory, mapped);
+        dedicatedBytes += size;
+        return allocation;
+    }
+
+    void releaseBlock(DeviceMemoryBlock &block)
+    {
+        if (block.mapped != nullptr)
+        {
+            backend.unmap(block.memory);
+        }
+        backend.free(block.memory);
+    }
+
+    DeviceMemoryBackend &backend;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity;
+    VkDeviceSize blockSize;
+
+    std::vector<std::vector<std::unique_ptr<DeviceMemoryBlock>>> pools;
+    std::vector<std::pair<VkDeviceMemory, bool>> dedicatedAllocations; // memory, mapped
+    VkDeviceSize dedicatedBytes = 0;
+};
+
+#endif // DEVICE_ALLOCATOR_H
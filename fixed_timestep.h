@@ -0,0 +1,116 @@
+/**
+ * Fixed-timestep scheduling for a simulation that runs independently of the frame rate.
+ *
+ * Integrating with the last frame time ties the simulation's cost and accuracy
+ * to the render rate, and a single hitch becomes a single huge step. A
+ * FixedTimestep instead collects the real time that has passed and pays it out
+ * as steps of a fixed length:
+ *
+ *      timestep.advance(frameMilliseconds);            once per frame
+ *      SimulationBatch batch = timestep.takeBatch();   once per submitted batch
+ *      ... record batch.substeps steps, draw with weight batch.alpha ...
+ *
+ * A batch never holds more than maxSubsteps steps. Time past that limit is
+ * dropped, not carried over. A long stall therefore slows the simulation for
+ * one frame, instead of making every later frame catch up and fall further
+ * behind. The time left over is less than one step and is returned as alpha.
+ * The renderer uses it to interpolate between the last two steps, so motion is
+ * smooth and lags the simulation by at most one step.
+ */
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * Steps to run for one batch.
+ */
+struct SimulationBatch
+{
+    uint32_t substeps = 0; // Steps of stepMilliseconds(), 0 if less than one step is due
+    float alpha = 0.0f;    // Fraction of a step left in the accumulator, in [0, 1)
+};
+
+/**
+ * Totals over the run.
+ */
+struct FixedTimestepStats
+{
+    uint64_t steps = 0;
+    uint64_t batches = 0;
+    uint64_t cappedBatches = 0;      // Batches that hit maxSubsteps and dropped time
+    double droppedMilliseconds = 0.0; // Real time the simulation never caught up with
+};
+
+class FixedTimestep
+{
+public:
+    /**
+     * @param stepMilliseconds Simulated time per step.
+     * @param maxSubsteps Most steps one batch may run, at least 1.
+     */
+    FixedTimestep(double stepMilliseconds, uint32_t maxSubsteps)
+        : step(stepMilliseconds), maxSubsteps(maxSubsteps)
+    {
+        if (stepMilliseconds <= 0.0 || maxSubsteps == 0)
+        {
+            throw std::runtime_error("fixed timestep needs a positive step and at least one substep per batch!");
+        }
+    }
+
+    /**
+     * Adds real time that has passed, e.g. the duration of the last frame.
+     */
+    void advance(double milliseconds)
+    {
+        accumulator += std::max(0.0, milliseconds);
+    }
+
+    /**
+     * Takes the whole steps that are due, capped at maxSubsteps.
+     */
+    SimulationBatch takeBatch()
+    {
+        uint64_t due = static_cast<uint64_t>(accumulator / step);
+
+        SimulationBatch batch;
+        batch.substeps = static_cast<uint32_t>(std::min<uint64_t>(due, maxSubsteps));
+        accumulator -= batch.substeps * step;
+
+        if (due > maxSubsteps)
+        {
+            double dropped = (due - maxSubsteps) * step;
+            accumulator -= dropped;
+            stats.droppedMilliseconds += dropped;
+            stats.cappedBatches++;
+        }
+
+        /* Rounding can leave the accumulator a hair outside [0, step) */
+        accumulator = std::min(std::max(accumulator, 0.0), step);
+        batch.alpha = std::min(static_cast<float>(accumulator / step), 1.0f - 1e-6f);
+
+        stats.steps += batch.substeps;
+        stats.batches++;
+        return batch;
+    }
+
+    double stepMilliseconds() const
+    {
+        return step;
+    }
+
+    const FixedTimestepStats &statistics() const
+    {
+        return stats;
+    }
+
+private:
+    double step;
+    uint32_t maxSubsteps;
+    double accumulator = 0.0; // Real time not yet simulated
+    FixedTimestepStats stats;
+};
+
+#endif // FIXED_TIMESTEP_H
@@ -0,0 +1,322 @@
+/**
+ * CPU frame timing for benchmark runs.
+ *
+ * The main loop brackets every frame with beginFrame()/endFrame(), and
+ * drawFrame() calls mark() at the end of each of its phases. A mark charges
+ * the time since the previous mark (or since beginFrame()) to the given phase,
+ * so a phase that occurs more than once per frame, such as the compute and the
+ * graphics fence waits, accumulates:
+ *
+ *      beginFrame()
+ *      vkWaitForFences(...)            mark(FramePhase::FenceWait)
+ *      vkAcquireNextImageKHR(...)      mark(FramePhase::Acquire)
+ *      recordCommandBuffer(...)        mark(FramePhase::Record)
+ *      vkQueueSubmit(...)              mark(FramePhase::Submit)
+ *      vkQueuePresentKHR(...)          mark(FramePhase::Present)
+ *      endFrame()
+ *
+ * The first warm-up frames are discarded. For the rest, report() prints
+ * min/avg/p50/p95/p99/max of the whole frame and of every phase plus the
+ * throughput, and writeJson() stores the same numbers for scripts.
+ */
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Parts of drawFrame() that are timed separately.
+ */
+enum class FramePhase
+{
+    FenceWait, // Waiting for the frame slot's previous submission
+    Acquire,   // vkAcquireNextImageKHR()
+    Record,    // Uniform update and command buffer recording
+    Submit,    // vkQueueSubmit()
+    Present,   // vkQueuePresentKHR()
+    Count
+};
+
+const char *const FRAME_PHASE_NAMES[] = {"fence_wait", "acquire", "record", "submit", "present"};
+
+/**
+ * Distribution of a set of frame time samples, in milliseconds.
+ */
+struct FrameTimeSummary
+{
+    double min = 0.0;
+    double avg = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+/**
+ * Summarizes 'samples' using nearest-rank percentiles.
+ */
+inline FrameTimeSummary summarizeFrameTimes(std::vector<double> samples)
+{
+    FrameTimeSummary summary;
+    if (samples.empty())
+    {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double p)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+        return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+    };
+
+    double sum = 0.0;
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+
+    summary.min = samples.front();
+    summary.avg = sum / samples.size();
+    summary.p50 = percentile(50.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    summary.max = samples.back();
+    return summary;
+}
+
+/**
+ * Quotes 'value' as a JSON string. Control characters, which JSON does not
+ * allow unescaped, are written as escape sequences.
+ */
+inline std::string jsonString(const std::string &value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    std::string escaped = "\"";
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"':
+            escaped += "\\\"";
+            break;
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\r':
+            escaped += "\\r";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                escaped += "\\u00";
+                escaped += hexDigits[static_cast<unsigned char>(c) >> 4];
+                escaped += hexDigits[static_cast<unsigned char>(c) & 0xF];
+            }
+            else
+            {
+                escaped += c;
+            }
+            break;
+        }
+    }
+    return escaped + "\"";
+}
+
+class FrameProfiler
+{
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    /**
+     * @param warmupFrames Frames to run before measuring.
+     * @param measuredFrames Expected number of measured frames, used to reserve
+     *        storage so that recording does not allocate.
+     */
+    explicit FrameProfiler(uint32_t warmupFrames = 0, uint32_t measuredFrames = 0)
+        : warmupFrames(warmupFrames)
+    {
+        frameTimes.reserve(measuredFrames);
+        for (std::vector<double> &times : phaseTimes)
+        {
+            times.reserve(measuredFrames);
+        }
+    }
+
+    void beginFrame()
+    {
+        frameStart = Clock::now();
+        lastMark = frameStart;
+        std::fill(std::begin(currentPhases), std::end(currentPhases), 0.0);
+    }
+
+    /**
+     * Charges the time since the previous mark to 'phase'.
+     */
+    void mark(FramePhase phase)
+    {
+        Clock::time_point now = Clock::now();
+        currentPhases[static_cast<size_t>(phase)] += std::chrono::duration<double, std::milli>(now - lastMark).count();
+        lastMark = now;
+    }
+
+    void endFrame()
+    {
+        Clock::time_point now = Clock::now();
+
+        if (framesSeen++ < warmupFrames)
+        {
+            return;
+        }
+        if (frameTimes.empty())
+        {
+            measureStart = frameStart;
+        }
+        measureEnd = now;
+
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(now - frameStart).count());
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            phaseTimes[i].push_back(currentPhases[i]);
+        }
+    }
+
+    /**
+     * Adds a key/value pair describing the run (device, resolution, ...) to the report.
+     */
+    void setInfo(const std::string &key, const std::string &value)
+    {
+        info.push_back(std::make_pair(key, value));
+    }
+
+    /**
+     * @return Number of measured frames so far.
+     */
+    size_t measuredFrames() const
+    {
+        return frameTimes.size();
+    }
+
+    /**
+     * @return Measured frames per second of wall-clock time.
+     */
+    double framesPerSecond() const
+    {
+        double seconds = std::chrono::duration<double>(measureEnd - measureStart).count();
+        return seconds > 0.0 ? frameTimes.size() / seconds : 0.0;
+    }
+
+    /**
+     * Prints the frame and phase time distributions as a table.
+     */
+    void report(std::ostream &out) const
+    {
+        out << "Benchmark: " << frameTimes.size() << " frames after " << warmupFrames << " warm-up frames, "
+            << framesPerSecond() << " frames/s" << std::endl;
+        for (const auto &entry : info)
+        {
+            out << "    " << entry.first << ": " << entry.second << std::endl;
+        }
+
+        out << std::left << std::setw(12) << "ms" << std::right;
+        for (const char *column : {"min", "avg", "p50", "p95", "p99", "max"})
+        {
+            out << std::setw(10) << column;
+        }
+        out << std::endl;
+
+        reportRow(out, "frame", summarizeFrameTimes(frameTimes));
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            reportRow(out, FRAME_PHASE_NAMES[i], summarizeFrameTimes(phaseTimes[i]));
+        }
+    }
+
+    /**
+     * Writes the report as JSON:
+     *
+     *      {"info": {...}, "warmup_frames": N, "measured_frames": M, "frames_per_second": F,
+     *       "frame_ms": {"min": ..., "avg": ..., "p50": ..., "p95": ..., "p99": ..., "max": ...},
+     *       "phases_ms": {"fence_wait": {...}, ...}}
+     */
+    void writeJson(const std::string &path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("failed to open benchmark report " + path + "!");
+        }
+
+        file << std::setprecision(6) << "{\n  \"info\": {";
+        for (size_t i = 0; i < info.size(); i++)
+        {
+            file << (i ? ", " : "") << jsonString(info[i].first) << ": " << jsonString(info[i].second);
+        }
+        file << "},\n";
+        file << "  \"warmup_frames\": " << warmupFrames << ",\n";
+        file << "  \"measured_frames\": " << frameTimes.size() << ",\n";
+        file << "  \"frames_per_second\": " << framesPerSecond() << ",\n";
+        file << "  \"frame_ms\": " << jsonSummary(summarizeFrameTimes(frameTimes)) << ",\n";
+        file << "  \"phases_ms\": {\n";
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            file << "    \"" << FRAME_PHASE_NAMES[i] << "\": " << jsonSummary(summarizeFrameTimes(phaseTimes[i]))
+                 << (i + 1 < PHASE_COUNT ? ",\n" : "\n");
+        }
+        file << "  }\n}\n";
+    }
+
+private:
+    static constexpr size_t PHASE_COUNT = static_cast<size_t>(FramePhase::Count);
+
+    static void reportRow(std::ostream &out, const char *name, const FrameTimeSummary &summary)
+    {
+        out << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << summary.min << std::setw(10) << summary.avg << std::setw(10) << summary.p50
+            << std::setw(10) << summary.p95 << std::setw(10) << summary.p99 << std::setw(10) << summary.max
+            << std::defaultfloat << std::endl;
+    }
+
+    static std::string jsonSummary(const FrameTimeSummary &summary)
+    {
+        std::ostringstream out;
+        out << std::setprecision(6) << "{\"min\": " << summary.min << ", \"avg\": " << summary.avg
+            << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+            << ", \"max\": " << summary.max << "}";
+        return out.str();
+    }
+
+    uint32_t warmupFrames;
+    uint32_t framesSeen = 0;
+
+    Clock::time_point frameStart;
+    Clock::time_point lastMark;
+    Clock::time_point measureStart;
+    Clock::time_point measureEnd;
+    double currentPhases[PHASE_COUNT] = {};
+
+    std::vector<double> frameTimes;
+    std::vector<double> phaseTimes[PHASE_COUNT];
+    std::vector<std::pair<std::string, std::string>> info;
+};
+
+#endif // FRAME_PROFILER_H
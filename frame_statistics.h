@@ -0,0 +1,344 @@
+/**
+ * Per-frame workload counters.
+ *
+ * Two sources are combined:
+ *
+ *      CommandCounters     CPU-side counts of the commands recorded for a frame
+ *                          (draws, dispatches, binds, barriers, descriptor
+ *                          updates). The application increments them next to the
+ *                          vkCmd*() calls and hands them over in endFrame().
+ *      Pipeline statistics VK_QUERY_TYPE_PIPELINE_STATISTICS queries around named
+ *                          scopes, counting what the GPU actually processed.
+ *
+ * The queries work like GpuTimer: one pool per frame in flight with one query
+ * per scope. begin() reads the scope's result from the last use of the frame
+ * slot without waiting, then resets the query and begins it. When the device
+ * lacks the pipelineStatisticsQuery feature, only the CPU counters are kept.
+ *
+ * Every frame's values can be written to a CSV stream in long format
+ * ("frame,source,counter,value"). report() prints per-frame averages and
+ * extremes, plus two derived ratios: vertex shader invocations per primitive,
+ * which shows post-transform cache efficiency, and fragment shader invocations
+ * per pixel, which shows overdraw.
+ */
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Commands recorded for one frame.
+ */
+struct CommandCounters
+{
+    uint64_t draws = 0;
+    uint64_t dispatches = 0;
+    uint64_t pipelineBinds = 0;
+    uint64_t descriptorSetBinds = 0;
+    uint64_t bufferBinds = 0; // vertex and index buffer binds
+    uint64_t barriers = 0;
+    uint64_t descriptorUpdates = 0;
+
+    /**
+     * Adds the commands counted elsewhere, e.g. by another recording thread.
+     */
+    CommandCounters &operator+=(const CommandCounters &other)
+    {
+        draws += other.draws;
+        dispatches += other.dispatches;
+        pipelineBinds += other.pipelineBinds;
+        descriptorSetBinds += other.descriptorSetBinds;
+        bufferBinds += other.bufferBinds;
+        barriers += other.barriers;
+        descriptorUpdates += other.descriptorUpdates;
+        return *this;
+    }
+};
+
+/*
+ * Pipeline statistics that are queried, in the order Vulkan writes them (bit order)
+ */
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+const size_t PIPELINE_STATISTIC_COUNT = 5;
+
+const char *const PIPELINE_STATISTIC_NAMES[PIPELINE_STATISTIC_COUNT] = {
+    "primitives", "vertex_invocations", "clipped_primitives", "fragment_invocations", "compute_invocations"};
+
+const size_t COMMAND_COUNTER_COUNT = 7;
+
+const char *const COMMAND_COUNTER_NAMES[COMMAND_COUNTER_COUNT] = {
+    "draws", "dispatches", "pipeline_binds", "descriptor_set_binds", "buffer_binds", "barriers", "descriptor_updates"};
+
+class FrameStatistics
+{
+public:
+    /**
+     * @param device Logical device.
+     * @param queriesEnabled Whether the device was created with the
+     *        pipelineStatisticsQuery feature.
+     * @param frameCount Number of frames in flight, one query pool each.
+     * @param scopeNames Names of the query scopes, in scope index order.
+     */
+    FrameStatistics(VkDevice device, bool queriesEnabled, uint32_t frameCount, const std::vector<std::string> &scopeNames)
+        : device(device), scopeNames(scopeNames), scopeTotals(scopeNames.size())
+    {
+        if (!queriesEnabled)
+        {
+            return;
+        }
+
+        slots.resize(frameCount);
+        for (Slot &slot : slots)
+        {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = static_cast<uint32_t>(scopeNames.size());
+            poolInfo.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+
+            if (vkCreateQueryPool(device, &poolInfo, nullptr, &slot.pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+            slot.pendingFrame.assign(scopeNames.size(), NOT_PENDING);
+        }
+    }
+
+    ~FrameStatistics()
+    {
+        for (Slot &slot : slots)
+        {
+            vkDestroyQueryPool(device, slot.pool, nullptr);
+        }
+    }
+
+    FrameStatistics(const FrameStatistics &) = delete;
+    FrameStatistics &operator=(const FrameStatistics &) = delete;
+
+    /**
+     * Sets a stream that receives a "frame,source,counter,value" line for every
+     * counter of every frame, or nullptr for none.
+     */
+    void setCsvOutput(std::ostream *out)
+    {
+        csv = out;
+        if (csv)
+        {
+            *csv << "frame,source,counter,value" << std::endl;
+        }
+    }
+
+    /**
+     * Begins the pipeline statistics query of 'scope'. Must be recorded outside
+     * a render pass, as it resets the query.
+     */
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope)
+    {
+        if (slots.empty())
+        {
+            return;
+        }
+
+        Slot &slot = slots[frame];
+        collect(slot, scope, 0);
+
+        vkCmdResetQueryPool(commandBuffer, slot.pool, scope, 1);
+        vkCmdBeginQuery(commandBuffer, slot.pool, scope, 0);
+        slot.pendingFrame[scope] = frameNumber;
+    }
+
+    void end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope)
+    {
+        if (slots.empty())
+        {
+            return;
+        }
+
+        vkCmdEndQuery(commandBuffer, slots[frame].pool, scope);
+    }
+
+    /**
+     * Closes the current frame with the commands recorded for it.
+     */
+    void endFrame(const CommandCounters &counters)
+    {
+        const uint64_t values[COMMAND_COUNTER_COUNT] = {
+            counters.draws, counters.dispatches, counters.pipelineBinds, counters.descriptorSetBinds,
+            counters.bufferBinds, counters.barriers, counters.descriptorUpdates};
+
+        commandTotals.add(values, COMMAND_COUNTER_COUNT);
+        if (csv)
+        {
+            for (size_t i = 0; i < COMMAND_COUNTER_COUNT; i++)
+            {
+                *csv << frameNumber << ",cpu," << COMMAND_COUNTER_NAMES[i] << "," << values[i] << "\n";
+            }
+        }
+        frameNumber++;
+    }
+
+    /**
+     * Waits for and collects all outstanding query results, e.g. after vkDeviceWaitIdle().
+     */
+    void flush()
+    {
+        for (Slot &slot : slots)
+        {
+            for (uint32_t scope = 0; scope < scopeNames.size(); scope++)
+            {
+                collect(slot, scope, VK_QUERY_RESULT_WAIT_BIT);
+            }
+        }
+    }
+
+    /**
+     * Prints the per-frame average, minimum and maximum of every counter.
+     *
+     * @param pixelCount Pixels per frame, for the fragment invocations per pixel ratio.
+     */
+    void report(std::ostream &out, uint64_t pixelCount) const
+    {
+        out << "Commands per frame (avg / min / max over " << commandTotals.samples << " frames):" << std::endl;
+        for (size_t i = 0; i < COMMAND_COUNTER_COUNT; i++)
+        {
+            reportRow(out, COMMAND_COUNTER_NAMES[i], commandTotals, i);
+        }
+
+        if (slots.empty())
+        {
+            out << "Pipeline statistics: not supported by the device" << std::endl;
+            return;
+        }
+
+        for (size_t scope = 0; scope < scopeNames.size(); scope++)
+        {
+            const Totals &totals = scopeTotals[scope];
+            out << "Pipeline statistics of " << scopeNames[scope] << " per frame (" << totals.samples << " frames):" << std::endl;
+            for (size_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++)
+            {
+                reportRow(out, PIPELINE_STATISTIC_NAMES[i], totals, i);
+            }
+
+            double primitives = totals.average(0);
+            double vertexInvocations = totals.average(1);
+            double fragmentInvocations = totals.average(3);
+            if (primitives > 0.0)
+            {
+                out << "    vertex invocations per primitive: " << vertexInvocations / primitives << std::endl;
+            }
+            if (fragmentInvocations > 0.0 && pixelCount > 0)
+            {
+                out << "    fragment invocations per pixel:   " << fragmentInvocations / pixelCount << std::endl;
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t NOT_PENDING = ~0ull;
+
+    struct Slot
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<uint64_t> pendingFrame; // Per scope: frame number whose statistics are in the pool
+    };
+
+    /*
+     * Running sum, minimum and maximum of a fixed set of counters.
+     */
+    struct Totals
+    {
+        uint64_t samples = 0;
+        std::vector<uint64_t> sum, min, max;
+
+        void add(const uint64_t *values, size_t count)
+        {
+            if (samples == 0)
+            {
+                sum.assign(count, 0);
+                min.assign(values, values + count);
+                max.assign(values, values + count);
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                sum[i] += values[i];
+                min[i] = std::min(min[i], values[i]);
+                max[i] = std::max(max[i], values[i]);
+            }
+            samples++;
+        }
+
+        double average(size_t i) const
+        {
+            return samples ? static_cast<double>(sum[i]) / samples : 0.0;
+        }
+    };
+
+    static void reportRow(std::ostream &out, const char *name, const Totals &totals, size_t i)
+    {
+        out << "    " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << totals.average(i) << std::defaultfloat
+            << std::setw(12) << (totals.samples ? totals.min[i] : 0) << std::setw(12) << (totals.samples ? totals.max[i] : 0) << std::endl;
+    }
+
+    /*
+     * Reads the scope's statistics if the query was used and its result is available.
+     */
+    void collect(Slot &slot, uint32_t scope, VkQueryResultFlags waitFlag)
+    {
+        if (slot.pendingFrame[scope] == NOT_PENDING)
+        {
+            return;
+        }
+
+        /* The statistics followed by the availability value */
+        uint64_t results[PIPELINE_STATISTIC_COUNT + 1] = {};
+        VkResult result = vkGetQueryPoolResults(device, slot.pool, scope, 1, sizeof(results), results, sizeof(results),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT | waitFlag);
+        if (result != VK_SUCCESS && result != VK_NOT_READY)
+        {
+            throw std::runtime_error("failed to read pipeline statistics queries!");
+        }
+
+        uint64_t frame = slot.pendingFrame[scope];
+        slot.pendingFrame[scope] = NOT_PENDING;
+        if (results[PIPELINE_STATISTIC_COUNT] == 0)
+        {
+            /* Dropped rather than waited for, so begin() never stalls */
+            return;
+        }
+
+        scopeTotals[scope].add(results, PIPELINE_STATISTIC_COUNT);
+        if (csv)
+        {
+            for (size_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++)
+            {
+                *csv << frame << "," << scopeNames[scope] << "," << PIPELINE_STATISTIC_NAMES[i] << "," << results[i] << "\n";
+            }
+        }
+    }
+
+    VkDevice device;
+    std::vector<std::string> scopeNames;
+    uint64_t frameNumber = 0;
+
+    std::vector<Slot> slots;
+    Totals commandTotals;
+    std::vector<Totals> scopeTotals;
+    std::ostream *csv = nullptr;
+};
+
+#endif // FRAME_STATISTICS_H
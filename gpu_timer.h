@@ -0,0 +1,351 @@
+/**
+ * GPU timing of command buffer scopes with timestamp queries.
+ *
+ * Every frame in flight owns a timestamp VkQueryPool with two queries per named
+ * scope. A scope is bracketed while recording:
+ *
+ *      timer.begin(commandBuffer, currentFrame, scope)   vkCmdWriteTimestamp(TOP_OF_PIPE)
+ *      ... render pass or dispatch ...
+ *      timer.end(commandBuffer, currentFrame, scope)     vkCmdWriteTimestamp(BOTTOM_OF_PIPE)
+ *
+ * begin() first picks up the result that the same scope wrote the last time this
+ * frame slot was used, MAX_FRAMES_IN_FLIGHT frames earlier. The caller has
+ * already waited for that submission's fence, so reading it never blocks. Then
+ * begin() resets only the scope's two queries. Scopes recorded into different
+ * command buffers, with different fences, therefore never touch each other's
+ * queries.
+ *
+ * Tick deltas are masked to the queue family's timestampValidBits and converted
+ * to milliseconds with timestampPeriod. Every result can be written to a CSV
+ * stream as it arrives, and report() summarizes each scope over the run.
+ *
+ * Scopes may be recorded on queues of different families, as long as each
+ * (slot, scope) pair is only reused after its fence. Besides the duration, every
+ * result keeps its begin and end time relative to the first timestamp read, so
+ * reportOverlap() can tell how long two scopes ran at the same time, e.g. a
+ * compute queue dispatch next to a graphics queue render pass. That assumes
+ * the queues share one time base, which Vulkan 1.0 does not promise but common
+ * drivers provide.
+ */
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <vulkan/vulkan.h>
+
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+class GpuTimer
+{
+public:
+    /**
+     * @param device Logical device.
+     * @param physicalDevice Device whose timestampPeriod converts ticks.
+     * @param queueFamilies Families of the queues the scopes are submitted to.
+     * @param frameCount Number of slots, one query pool each: frames in flight,
+     *        or more if some scope is recorded several times per frame.
+     * @param scopeNames Names of the scopes, in scope index order.
+     */
+    GpuTimer(VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilies, uint32_t frameCount, const std::vector<std::string> &scopeNames)
+        : device(device), scopeNames(scopeNames), samples(scopeNames.size()), intervals(scopeNames.size())
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+        /* Every family has to support timestamps, and the narrowest one sets the mask */
+        uint32_t validBits = 64;
+        for (uint32_t queueFamily : queueFamilies)
+        {
+            validBits = std::min(validBits, queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0);
+        }
+        if (validBits == 0)
+        {
+            /* Leave the timer disabled, all calls become no-ops */
+            return;
+        }
+        this->validBits = validBits;
+        validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        slots.resize(frameCount);
+        for (Slot &slot : slots)
+        {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = static_cast<uint32_t>(2 * scopeNames.size());
+
+            if (vkCreateQueryPool(device, &poolInfo, nullptr, &slot.pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+            slot.pendingFrame.assign(scopeNames.size(), NOT_PENDING);
+        }
+    }
+
+    ~GpuTimer()
+    {
+        for (Slot &slot : slots)
+        {
+            vkDestroyQueryPool(device, slot.pool, nullptr);
+        }
+    }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    /**
+     * @return False if the queue family does not support timestamps.
+     */
+    bool enabled() const
+    {
+        return !slots.empty();
+    }
+
+    /**
+     * Sets a stream that receives a "frame,scope,milliseconds,begin_ms,end_ms"
+     * line for every result, or nullptr for none. begin_ms and end_ms are
+     * relative to the first timestamp read.
+     */
+    void setCsvOutput(std::ostream *out)
+    {
+        csv = out;
+        if (csv)
+        {
+            *csv << "frame,scope,milliseconds,begin_ms,end_ms" << std::endl;
+        }
+    }
+
+    /**
+     * Starts a new frame number. Call once per drawFrame(), before any begin().
+     */
+    void nextFrame()
+    {
+        frameNumber++;
+    }
+
+    /**
+     * Writes the start timestamp of 'scope'. Must be recorded outside a render
+     * pass, as it resets the scope's queries.
+     */
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        Slot &slot = slots[frame];
+        collect(slot, scope, 0);
+
+        vkCmdResetQueryPool(commandBuffer, slot.pool, 2 * scope, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool, 2 * scope);
+        slot.pendingFrame[scope] = frameNumber;
+    }
+
+    /**
+     * Writes the end timestamp of 'scope', once all preceding commands have completed.
+     */
+    void end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slots[frame].pool, 2 * scope + 1);
+    }
+
+    /**
+     * Waits for and collects all outstanding results, e.g. after vkDeviceWaitIdle().
+     */
+    void flush()
+    {
+        for (Slot &slot : slots)
+        {
+            for (uint32_t scope = 0; scope < scopeNames.size(); scope++)
+            {
+                collect(slot, scope, VK_QUERY_RESULT_WAIT_BIT);
+            }
+        }
+    }
+
+    /**
+     * Prints min/avg/p99/max GPU time per scope over the run.
+     */
+    void report(std::ostream &out) const
+    {
+        if (!enabled())
+        {
+            out << "GPU timestamps: not supported by the queue family" << std::endl;
+            return;
+        }
+
+        out << "GPU time per scope (ms):" << std::endl;
+        for (size_t scope = 0; scope < scopeNames.size(); scope++)
+        {
+            FrameTimeSummary summary = summarizeFrameTimes(samples[scope]);
+            out << "    " << std::left << std::setw(18) << scopeNames[scope] << std::right << std::fixed << std::setprecision(3)
+                << " min " << summary.min << "  avg " << summary.avg << "  p99 " << summary.p99 << "  max " << summary.max
+                << std::defaultfloat << "  (" << samples[scope].size() << " frames)" << std::endl;
+        }
+    }
+
+    /**
+     * Prints how much of the GPU time of 'scope' was spent while 'other' was
+     * running too, e.g. on another queue.
+     */
+    void reportOverlap(std::ostream &out, uint32_t scope, uint32_t other) const
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        std::vector<std::pair<double, double>> busy = mergeIntervals(intervals[scope]);
+        std::vector<std::pair<double, double>> otherBusy = mergeIntervals(intervals[other]);
+
+        double total = 0.0;
+        for (const std::pair<double, double> &interval : busy)
+        {
+            total += interval.second - interval.first;
+        }
+
+        /* Both lists are sorted and disjoint, so one pass intersects them */
+        double overlap = 0.0;
+        size_t i = 0, j = 0;
+        while (i < busy.size() && j < otherBusy.size())
+        {
+            overlap += std::max(0.0, std::min(busy[i].second, otherBusy[j].second) - std::max(busy[i].first, otherBusy[j].first));
+            if (busy[i].second < otherBusy[j].second)
+            {
+                i++;
+            }
+            else
+            {
+                j++;
+            }
+        }
+
+        out << scopeNames[scope] << " ran alongside " << scopeNames[other] << " for " << std::fixed << std::setprecision(3)
+            << overlap << " of " << total << " ms (" << std::setprecision(1) << (total > 0.0 ? 100.0 * overlap / total : 0.0)
+            << "%)" << std::defaultfloat << std::endl;
+    }
+
+private:
+    static constexpr uint64_t NOT_PENDING = ~0ull;
+
+    struct Slot
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<uint64_t> pendingFrame; // Per scope: frame number whose timestamps are in the pool
+    };
+
+    /*
+     * Reads the scope's two timestamps if they were written and are available.
+     */
+    void collect(Slot &slot, uint32_t scope, VkQueryResultFlags waitFlag)
+    {
+        if (slot.pendingFrame[scope] == NOT_PENDING)
+        {
+            return;
+        }
+
+        /* Two {timestamp, availability} pairs */
+        uint64_t results[4] = {};
+        VkResult result = vkGetQueryPoolResults(device, slot.pool, 2 * scope, 2, sizeof(results), results, 2 * sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT | waitFlag);
+        if (result != VK_SUCCESS && result != VK_NOT_READY)
+        {
+            throw std::runtime_error("failed to read timestamp queries!");
+        }
+        if (results[1] == 0 || results[3] == 0)
+        {
+            /* Dropped rather than waited for, so begin() never stalls */
+            slot.pendingFrame[scope] = NOT_PENDING;
+            return;
+        }
+
+        double milliseconds = static_cast<double>((results[2] - results[0]) & validMask) * timestampPeriod / 1e6;
+        samples[scope].push_back(milliseconds);
+
+        if (!epochSet)
+        {
+            epoch = results[0];
+            epochSet = true;
+        }
+        double begin = static_cast<double>(ticksSinceEpoch(results[0])) * timestampPeriod / 1e6;
+        intervals[scope].emplace_back(begin, begin + milliseconds);
+
+        if (csv)
+        {
+            *csv << slot.pendingFrame[scope] << "," << scopeNames[scope] << "," << milliseconds << "," << begin << "," << begin + milliseconds << "\n";
+        }
+        slot.pendingFrame[scope] = NOT_PENDING;
+    }
+
+    /*
+     * Signed distance of 'timestamp' from the epoch, which may lie on either
+     * side of it since scopes are not collected in execution order.
+     */
+    int64_t ticksSinceEpoch(uint64_t timestamp) const
+    {
+        uint64_t delta = (timestamp - epoch) & validMask;
+        if (validBits < 64 && (delta >> (validBits - 1)) != 0)
+        {
+            return static_cast<int64_t>(delta) - (static_cast<int64_t>(1) << validBits);
+        }
+        return static_cast<int64_t>(delta);
+    }
+
+    /*
+     * Sorts intervals and merges the overlapping ones.
+     */
+    static std::vector<std::pair<double, double>> mergeIntervals(std::vector<std::pair<double, double>> sorted)
+    {
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<std::pair<double, double>> merged;
+        for (const std::pair<double, double> &interval : sorted)
+        {
+            if (!merged.empty() && interval.first <= merged.back().second)
+            {
+                merged.back().second = std::max(merged.back().second, interval.second);
+            }
+            else
+            {
+                merged.push_back(interval);
+            }
+        }
+        return merged;
+    }
+
+    VkDevice device;
+    std::vector<std::string> scopeNames;
+    float timestampPeriod = 1.0f; // Nanoseconds per tick
+    uint64_t validMask = 0;
+    uint32_t validBits = 0;
+    uint64_t frameNumber = 0;
+    uint64_t epoch = 0; // First timestamp read, the origin of the intervals
+    bool epochSet = false;
+
+    std::vector<Slot> slots;
+    std::vector<std::vector<double>> samples; // Per scope, in milliseconds
+    std::vector<std::vector<std::pair<double, double>>> intervals; // Per scope, begin and end in milliseconds since the epoch
+    std::ostream *csv = nullptr;
+};
+
+#endif // GPU_TIMER_H
@@ -7,10 +7,8 @@
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -18,6 +16,23 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include "mesh_cache.h"
+#include "vertex_welder.h"
+#include "obj_parallel_loader.h"
+#include "mesh_optimizer.h"
+#include "mesh_splitter.h"
+#include "device_allocator.h"
+#include "staging_ring.h"
+#include "upload_batcher.h"
+#include "frame_profiler.h"
+#include "gpu_timer.h"
+#include "frame_statistics.h"
+#include "startup_profiler.h"
+#include "pipeline_cache.h"
+#include "pipeline_compiler.h"
+#include "shader_library.h"
+#include "command_recorder.h"
+
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -25,13 +40,16 @@
 #include <chrono>
 #include <vector>
 #include <cstring>
+#include <deque>
 #include <cstdlib>
 #include <cstdint>
+#include <cmath>
 #include <limits>
+#include <memory>
 #include <array>
 #include <optional>
 #include <set>
-#include <unordered_map>
+#include <string>
 
 /*
  * Variables for window dimensions
@@ -39,17 +57,42 @@
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+/*
+ * Frames rendered by a headless run unless --frames says otherwise
+ */
+const uint32_t HEADLESS_DEFAULT_FRAMES = 100;
+
+/*
+ * Pipeline cache file, relative to the working directory
+ */
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
 /*
  * Model and textures
  */
 const std::string MODEL_PATH = "/Users/stevencheng/CLionProjects/VulkanTutorial/models/viking_room.obj";
 const std::string TEXTURE_PATH = "/Users/stevencheng/CLionProjects/VulkanTutorial/textures/viking_room.png";
 
+/*
+ * Binary cache of the welded model, rebuilt automatically when the OBJ changes
+ */
+const std::string MODEL_CACHE_PATH = MODEL_PATH + ".meshcache";
+
+/*
+ * Mesh cache flags, describing which post-processing the cached mesh went through
+ */
+const uint32_t MESH_CACHE_FLAG_OPTIMIZED = 1 << 0;
+
 /*
  * Max frames in buffer
  */
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+/*
+ * GPU query scopes, see --gpu-timestamps and --frame-stats
+ */
+const uint32_t GPU_SCOPE_RENDER_PASS = 0;
+
 /*
  * Validation layers used
  */
@@ -71,6 +114,49 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+/**
+ * Vertex layouts the model can be uploaded in.
+ *      Float:  32-byte Vertex (float position, color and texture coordinate)
+ *      Packed: 12-byte PackedVertex (16-bit normalized position and texture coordinate)
+ */
+enum class VertexFormat
+{
+    Float,
+    Packed
+};
+
+/**
+ * Options that can be set from the command line, see parseOptions().
+ */
+struct ApplicationOptions
+{
+    unsigned loaderThreads = 0; // OBJ parsing threads: 0 = one per hardware thread, 1 = serial tinyobj loader
+    bool verifyLoader = false;  // Compare the parallel OBJ loader against the serial one at startup
+    bool optimizeMesh = false;  // Reorder the model for vertex cache and vertex fetch locality after loading
+    VertexFormat vertexFormat = VertexFormat::Float;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16; // 16-bit indices split the model into 65536-vertex chunks as needed
+    VkDeviceSize stagingSize = STAGING_RING_DEFAULT_SIZE; // Capacity of the staging ring all uploads go through
+    bool immediateUploads = false; // Submit and wait for every upload command instead of batching them
+    bool transferQueue = true;     // Upload on a dedicated transfer queue family when the device has one
+    bool headless = false;         // Render offscreen without GLFW, a surface or a swap chain
+    uint32_t width = WIDTH;        // Window or offscreen image size
+    uint32_t height = HEIGHT;
+    uint32_t frames = 0; // Frames to render before exiting, 0 = until the window is closed
+    uint32_t benchmarkFrames = 0;    // Frames to measure after the warm-up, 0 = no benchmark
+    uint32_t warmupFrames = 60;      // Frames to run before measuring
+    std::string benchmarkJson = "benchmark.json"; // Machine-readable benchmark report
+    std::string gpuTimestamps; // CSV file receiving per-frame GPU scope times, empty = no GPU timing
+    std::string frameStatistics; // CSV file receiving per-frame command counts and pipeline statistics, empty = none
+    bool startupReport = false; // Print wall and CPU time per initialization stage
+    std::string startupJson;    // Machine-readable startup report, empty = none
+    bool exitAfterInit = false; // Exit right after initialization, without drawing a frame
+    std::string pipelineCache = PIPELINE_CACHE_PATH; // Pipeline cache file, empty = compile every launch
+    unsigned pipelineThreads = 1; // Background pipeline compile threads, 0 = compile inside initVulkan()
+    bool staticCommandBuffers = false; // Record the frame's commands once per framebuffer instead of every frame
+    unsigned recordThreads = 0; // Threads recording the render pass into secondary command buffers, 0 = inline
+    uint32_t drawRepeat = 1;    // Times the model's draws are repeated per frame, for a synthetic many-draw scene
+};
+
 /**
  * Create a debug messenger for debugging and validation purposes.
  *
@@ -118,6 +204,7 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // Transfer-only family, optional
 
     bool isComplete()
     {
@@ -204,27 +291,70 @@ struct Vertex
     }
 };
 
-/*
- * This specialization provides a hash function for the Vertex struct, allowing it
- * to be used as a key in hash-based containers.
- *
- * The hash value is calculated by combining the hash values of the position, color,
- * and texture coordinate components using bitwise XOR and left shift operations.
+/**
+ * Compact vertex layout used with VertexFormat::Packed, 12 instead of 32 bytes.
+ * Positions are stored as 16-bit unsigned normalized values relative to the mesh
+ * bounding box and texture coordinates relative to the UV bounds. The per-vertex
+ * color is dropped as it is constant for our models. The ranges needed to decode
+ * and the color are passed to shaderQuantized.vert as push constants (see
+ * VertexQuantization).
  */
-namespace std
+struct PackedVertex
 {
-    template <>
-    struct hash<Vertex>
+    uint16_t pos[4]; // x, y, z and padding: 3-component 16-bit formats are rarely supported as vertex input
+    uint16_t texCoord[2];
+
+    /**
+     * Retrieves the vertex input binding description.
+     *
+     * @return VkVertexInputBindingDescription - The binding description for a tightly packed PackedVertex array.
+     */
+    static VkVertexInputBindingDescription getBindingDescription()
     {
-        size_t operator()(Vertex const &vertex) const
-        {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                     (hash<glm::vec3>()(vertex.color) << 1)) >>
-                    1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(PackedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    /**
+     * Describes the two packed attributes. The UNORM formats make the input
+     * assembler convert them to floats in [0, 1], which the shader rescales.
+     *
+     * @return std::array<VkVertexInputAttributeDescription, 2> The position and texture coordinate attributes.
+     */
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
+
+        return attributeDescriptions;
+    }
+};
+
+/**
+ * Push constants of shaderQuantized.vert, describing how to decode PackedVertex:
+ *      position = positionOffset + pos * positionScale
+ *      texCoord = texCoordOffsetScale.xy + texCoord * texCoordOffsetScale.zw
+ */
+struct VertexQuantization
+{
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+    glm::vec4 texCoordOffsetScale;
+    glm::vec4 color;
+};
 
 /**
  * Vulkan expects data in structures to be aligned in memory according to specific rules:
@@ -250,30 +380,65 @@ struct UniformBufferObject
 class HelloTriangleApplication
 {
 public:
+    explicit HelloTriangleApplication(const ApplicationOptions &options)
+        : options(options), profiler(options.warmupFrames, options.benchmarkFrames), pipelineCompiler(options.pipelineThreads)
+    {
+    }
+
     /**
      * Runs all Vulkan functions
      */
     void run()
     {
-        initWindow();
+        if (!options.headless)
+        {
+            initWindow();
+            startup.mark("initWindow");
+        }
         initVulkan();
-        mainLoop();
+
+        if (options.exitAfterInit)
+        {
+            /* Uploads and pipeline compiles may still be in flight */
+            vkDeviceWaitIdle(device);
+            graphicsPipeline.get();
+            finishStartup("waitForBackgroundWork");
+        }
+        else
+        {
+            mainLoop();
+        }
         cleanup();
     }
 
 private:
-    GLFWwindow *window;
+    ApplicationOptions options;
+    FrameProfiler profiler; // CPU frame and drawFrame() phase times for --benchmark
+    StartupProfiler startup; // Time per initialization stage, started when the application is constructed
+    std::unique_ptr<PersistentPipelineCache> pipelineCache; // Used for every pipeline creation
+    PipelineCompiler pipelineCompiler; // Compiles pipelines while the rest of initVulkan() runs
+    std::unique_ptr<GpuTimer> gpuTimer; // GPU time per scope, only with --gpu-timestamps
+    std::ofstream gpuTimestampFile;
+    CommandCounters commandCounters; // Commands recorded for the current frame
+    std::unique_ptr<FrameStatistics> frameStatistics; // Per-frame counters, only with --frame-stats
+    std::ofstream frameStatisticsFile;
+    bool pipelineStatisticsEnabled = false; // Device created with the pipelineStatisticsQuery feature
+
+    GLFWwindow *window = nullptr;
 
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
-    VkSurfaceKHR surface; // For showing results to the screen
+    VkSurfaceKHR surface = VK_NULL_HANDLE; // For showing results to the screen, none when headless
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
     VkDevice device; // logical device
 
+    QueueFamilyIndices queueFamilies; // Families the logical device was created with
+
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue; // Upload queue, graphicsQueue when there is no dedicated transfer family
 
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
@@ -281,43 +446,62 @@ private:
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
+    std::vector<DeviceAllocation> offscreenImageAllocations; // Headless only: memory of swapChainImages
 
     VkRenderPass renderPass;
     VkDescriptorSetLayout descriptorSetLayout;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    AsyncPipeline graphicsPipeline;
 
     VkCommandPool commandPool;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+    std::unique_ptr<VulkanMemoryBackend> memoryBackend;
+    std::unique_ptr<DeviceAllocator> allocator;
+
+    VkBuffer stagingRingBuffer;
+    DeviceAllocation stagingRingAllocation;
+    std::unique_ptr<StagingRing> stagingRing;
+    std::unique_ptr<UploadBatcher> uploads;         // Copies, on transferQueue
+    std::unique_ptr<UploadBatcher> graphicsUploads; // Ownership acquires and mipmap blits, only with a dedicated transfer queue
+    std::deque<std::pair<UploadToken, VkSemaphore>> uploadSemaphores; // Transfer to graphics handoffs in flight
 
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
+    DeviceAllocation colorImageAllocation;
     VkImageView colorImageView;
 
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    DeviceAllocation depthImageAllocation;
     VkImageView depthImageView;
 
     uint32_t mipLevels;
     VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    DeviceAllocation textureImageAllocation;
     VkImageView textureImageView;
     VkSampler textureSampler;
 
     std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packedVertices;
+    VertexQuantization vertexQuantization{};
     std::vector<uint32_t> indices;
+    std::vector<uint16_t> indices16;
+    std::vector<MeshChunk> meshChunks;
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    DeviceAllocation vertexBufferAllocation;
     VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    DeviceAllocation indexBufferAllocation;
 
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<DeviceAllocation> uniformBuffersAllocations;
     std::vector<void *> uniformBuffersMapped;
 
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
 
     std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkCommandBuffer> staticCommandBuffers; // --static-command-buffers, indexed by image * MAX_FRAMES_IN_FLIGHT + frame
+    std::unique_ptr<ParallelCommandRecorder> commandRecorder; // Secondary command buffers, only with --record-threads
+    std::vector<CommandCounters> recorderCommandCounters;     // Per recording thread, added to commandCounters
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
@@ -329,7 +513,8 @@ private:
     /**
      * The given code initializes a window using the GLFW library and creates a non-resizable window for Vulkan
      * rendering. It sets up the necessary window hints, such as not using any specific graphics API by default. The
-     * window created has a fixed size of 800x600 pixels and a title of "Vulkan".
+     * window created has a size of 800x600 pixels unless set with --width and
+     * --height, and a title of "Vulkan".
      */
     void initWindow()
     {
@@ -337,7 +522,7 @@ private:
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int>(options.width), static_cast<int>(options.height), "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
     }
@@ -361,45 +546,280 @@ private:
     void initVulkan()
     {
         createInstance();
+        startup.mark("createInstance");
         setupDebugMessenger();
-        createSurface();
+        startup.mark("setupDebugMessenger");
+        if (!options.headless)
+        {
+            createSurface();
+            startup.mark("createSurface");
+        }
         pickPhysicalDevice();
+        startup.mark("pickPhysicalDevice");
         createLogicalDevice();
-        createSwapChain();
+        startup.mark("createLogicalDevice");
+        createAllocator();
+        startup.mark("createAllocator");
+        createPipelineCache();
+        startup.mark("createPipelineCache");
+        if (options.headless)
+        {
+            createOffscreenImages();
+            startup.mark("createOffscreenImages");
+        }
+        else
+        {
+            createSwapChain();
+            startup.mark("createSwapChain");
+        }
         createImageViews();
+        startup.mark("createImageViews");
         createRenderPass();
+        startup.mark("createRenderPass");
         createDescriptorSetLayout();
+        startup.mark("createDescriptorSetLayout");
         createGraphicsPipeline();
+        startup.mark("createGraphicsPipeline");
         createCommandPool();
+        startup.mark("createCommandPool");
+        createStagingRing();
+        startup.mark("createStagingRing");
         createColorResources();
+        startup.mark("createColorResources");
         createDepthResources();
+        startup.mark("createDepthResources");
         createFramebuffers();
+        startup.mark("createFramebuffers");
+        auto uploadStart = std::chrono::high_resolution_clock::now();
         createTextureImage();
+        startup.mark("createTextureImage");
         createTextureImageView();
+        startup.mark("createTextureImageView");
         createTextureSampler();
+        startup.mark("createTextureSampler");
         loadModel();
+        startup.mark("loadModel");
+        splitModel();
+        startup.mark("splitModel");
+        quantizeModel();
+        startup.mark("quantizeModel");
         createVertexBuffer();
+        startup.mark("createVertexBuffer");
         createIndexBuffer();
+        startup.mark("createIndexBuffer");
+        submitUploads();
+        startup.mark("submitUploads");
+        double uploadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - uploadStart).count();
         createUniformBuffers();
+        startup.mark("createUniformBuffers");
         createDescriptorPool();
+        startup.mark("createDescriptorPool");
         createDescriptorSets();
+        startup.mark("createDescriptorSets");
         createCommandBuffers();
+        startup.mark("createCommandBuffers");
+        createCommandRecorder();
+        startup.mark("createCommandRecorder");
         createSyncObjects();
+        startup.mark("createSyncObjects");
+        createGpuTimer();
+        startup.mark("createGpuTimer");
+        createFrameStatistics();
+        startup.mark("createFrameStatistics");
+        printAllocatorStats();
+        printUploadStats(uploadMilliseconds);
     }
 
     /**
-     * Loop that iterates until the window is closed. Once window is closed,
-     * deallocates resources we've used in the cleanup function
+     * Loop that iterates until the window is closed, or until --frames frames
+     * have been drawn. Once window is closed, deallocates resources we've used
+     * in the cleanup function
      */
     void mainLoop()
     {
-        while (!glfwWindowShouldClose(window))
+        auto startTime = std::chrono::high_resolution_clock::now();
+        uint32_t frameCount = 0;
+
+        if (options.headless)
+        {
+            for (; frameCount < options.frames; frameCount++)
+            {
+                profiler.beginFrame();
+                drawFrame();
+                profiler.endFrame();
+                endFrameStatistics();
+                if (frameCount == 0)
+                {
+                    finishStartup("firstFrame");
+                }
+            }
+        }
+        else
         {
-            glfwPollEvents();
-            drawFrame();
+            while (!glfwWindowShouldClose(window) && (options.frames == 0 || frameCount < options.frames))
+            {
+                glfwPollEvents();
+                profiler.beginFrame();
+                drawFrame();
+                profiler.endFrame();
+                endFrameStatistics();
+                if (frameCount == 0)
+                {
+                    finishStartup("firstFrame");
+                }
+                frameCount++;
+            }
         }
 
         vkDeviceWaitIdle(device);
+
+        if (gpuTimer)
+        {
+            gpuTimer->flush();
+            gpuTimer->report(std::cout);
+        }
+
+        if (frameStatistics)
+        {
+            frameStatistics->flush();
+            frameStatistics->report(std::cout, static_cast<uint64_t>(swapChainExtent.width) * swapChainExtent.height);
+        }
+
+        if (options.benchmarkFrames > 0)
+        {
+            reportBenchmark();
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Rendered " << frameCount << " frames at " << swapChainExtent.width << "x" << swapChainExtent.height
+                  << " in " << milliseconds << " ms (" << (frameCount ? milliseconds / frameCount : 0.0) << " ms per frame)" << std::endl;
+    }
+
+    /**
+     * Creates the pipeline cache, seeded from the file the previous run saved
+     * unless --no-pipeline-cache is given. It is written back in cleanup().
+     */
+    void createPipelineCache()
+    {
+        pipelineCache.reset(new PersistentPipelineCache(device, physicalDevice, options.pipelineCache));
+    }
+
+    /**
+     * Creates the timestamp queries behind --gpu-timestamps. Per-frame results
+     * go to the given CSV file, the summary is printed at exit.
+     */
+    void createGpuTimer()
+    {
+        if (options.gpuTimestamps.empty())
+        {
+            return;
+        }
+
+        gpuTimestampFile.open(options.gpuTimestamps);
+        if (!gpuTimestampFile)
+        {
+            throw std::runtime_error("failed to open " + options.gpuTimestamps + "!");
+        }
+
+        gpuTimer.reset(new GpuTimer(device, physicalDevice, {queueFamilies.graphicsFamily.value()}, MAX_FRAMES_IN_FLIGHT, {"render_pass"}));
+        gpuTimer->setCsvOutput(&gpuTimestampFile);
+    }
+
+    /**
+     * Creates the counters behind --frame-stats. Pipeline statistics queries are
+     * only added if the device supports them.
+     */
+    void createFrameStatistics()
+    {
+        if (options.frameStatistics.empty())
+        {
+            return;
+        }
+
+        frameStatisticsFile.open(options.frameStatistics);
+        if (!frameStatisticsFile)
+        {
+            throw std::runtime_error("failed to open " + options.frameStatistics + "!");
+        }
+
+        frameStatistics.reset(new FrameStatistics(device, pipelineStatisticsEnabled, MAX_FRAMES_IN_FLIGHT, {"render_pass"}));
+        frameStatistics->setCsvOutput(&frameStatisticsFile);
+    }
+
+    /**
+     * Hands the commands recorded for the frame just drawn to --frame-stats and
+     * starts counting the next one.
+     */
+    void endFrameStatistics()
+    {
+        if (frameStatistics)
+        {
+            frameStatistics->endFrame(commandCounters);
+        }
+        commandCounters = CommandCounters();
+    }
+
+    /**
+     * Closes the startup profile with 'stage', the work between the end of
+     * initVulkan() and the first frame (or the end of background work with
+     * --exit-after-init), and reports it if requested.
+     */
+    void finishStartup(const char *stage)
+    {
+        startup.mark(stage);
+        if (options.startupReport)
+        {
+            reportStartup();
+        }
+    }
+
+    /**
+     * Prints the time spent in each initialization stage and writes it to
+     * --startup-json if given.
+     */
+    void reportStartup()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        startup.setInfo("application", "model viewer");
+        startup.setInfo("device", properties.deviceName);
+        startup.setInfo("mode", options.headless ? "headless" : "windowed");
+        startup.setInfo("pipeline_cache", pipelineCache->status());
+        startup.setInfo("pipeline_threads", std::to_string(pipelineCompiler.threadCount()));
+        startup.setInfo("graphics_pipeline_compile_ms", std::to_string(graphicsPipeline.compileMilliseconds()));
+        startup.setInfo("graphics_pipeline_wait_ms", std::to_string(graphicsPipeline.waitMilliseconds()));
+        startup.setInfo("msaa_samples", std::to_string(msaaSamples));
+        startup.setInfo("loader_threads", std::to_string(options.loaderThreads));
+        startup.report(std::cout);
+
+        if (!options.startupJson.empty())
+        {
+            startup.writeJson(options.startupJson);
+            std::cout << "Startup report written to " << options.startupJson << std::endl;
+        }
+    }
+
+    /**
+     * Prints the benchmark results and writes them to --benchmark-json.
+     */
+    void reportBenchmark()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        profiler.setInfo("application", "model viewer");
+        profiler.setInfo("device", properties.deviceName);
+        profiler.setInfo("resolution", std::to_string(swapChainExtent.width) + "x" + std::to_string(swapChainExtent.height));
+        profiler.setInfo("mode", options.headless ? "headless" : "windowed");
+        profiler.setInfo("msaa_samples", std::to_string(msaaSamples));
+        profiler.setInfo("vertex_format", options.vertexFormat == VertexFormat::Packed ? "packed" : "float");
+        profiler.setInfo("command_buffers", options.staticCommandBuffers ? "static" : "recorded per frame");
+        profiler.setInfo("record_threads", std::to_string(options.recordThreads));
+        profiler.setInfo("draws_per_frame", std::to_string(drawCount()));
+        profiler.report(std::cout);
+        profiler.writeJson(options.benchmarkJson);
+        std::cout << "Benchmark report written to " << options.benchmarkJson << std::endl;
     }
 
     /**
@@ -412,11 +832,11 @@ private:
     {
         vkDestroyImageView(device, depthImageView, nullptr);
         vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+        allocator->free(depthImageAllocation);
 
         vkDestroyImageView(device, colorImageView, nullptr);
         vkDestroyImage(device, colorImage, nullptr);
-        vkFreeMemory(device, colorImageMemory, nullptr);
+        allocator->free(colorImageAllocation);
 
         for (auto framebuffer : swapChainFramebuffers)
         {
@@ -428,7 +848,18 @@ private:
             vkDestroyImageView(device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (options.headless)
+        {
+            for (size_t i = 0; i < swapChainImages.size(); i++)
+            {
+                vkDestroyImage(device, swapChainImages[i], nullptr);
+                allocator->free(offscreenImageAllocations[i]);
+            }
+        }
+        else
+        {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
     }
 
     /**
@@ -439,14 +870,14 @@ private:
     {
         cleanupSwapChain();
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+        vkDestroyPipeline(device, graphicsPipeline.get(), nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
             vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            allocator->free(uniformBuffersAllocations[i]);
         }
 
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -455,15 +886,15 @@ private:
         vkDestroyImageView(device, textureImageView, nullptr);
 
         vkDestroyImage(device, textureImage, nullptr);
-        vkFreeMemory(device, textureImageMemory, nullptr);
+        allocator->free(textureImageAllocation);
 
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
         vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexBufferMemory, nullptr);
+        allocator->free(indexBufferAllocation);
 
         vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        allocator->free(vertexBufferAllocation);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
@@ -472,7 +903,35 @@ private:
             vkDestroyFence(device, inFlightFences[i], nullptr);
         }
 
+        /*
+         * The batchers free their command buffers on destruction, so they go
+         * before the command pools
+         */
+        graphicsUploads.reset();
+        uploads.reset();
+        recycleUploadSemaphores(true);
+        stagingRing.reset();
+        vkDestroyBuffer(device, stagingRingBuffer, nullptr);
+        allocator->free(stagingRingAllocation);
+
+        if (transferCommandPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(device, transferCommandPool, nullptr);
+        }
         vkDestroyCommandPool(device, commandPool, nullptr);
+        commandRecorder.reset();
+
+        gpuTimer.reset();
+        frameStatistics.reset();
+
+        if (!pipelineCache->save())
+        {
+            std::cerr << "failed to write pipeline cache " << options.pipelineCache << std::endl;
+        }
+        pipelineCache.reset();
+
+        allocator.reset();
+        memoryBackend.reset();
 
         vkDestroyDevice(device, nullptr);
 
@@ -484,9 +943,12 @@ private:
         vkDestroySurfaceKHR(instance, surface, nullptr);
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
+        if (!options.headless)
+        {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
     }
 
     /**
@@ -512,6 +974,7 @@ private:
 
         vkDeviceWaitIdle(device);
 
+        freeStaticCommandBuffers();
         cleanupSwapChain();
 
         createSwapChain();
@@ -683,10 +1146,16 @@ private:
      * validation layers if enabled.
      * If the logical device creation is successful, it retrieves the handle for the
      * graphics queue.
+     * A dedicated transfer family, when present and not disabled with
+     * --no-transfer-queue, gets a queue of its own for uploads.
      */
     void createLogicalDevice()
     {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        if (!options.transferQueue)
+        {
+            indices.transferFamily.reset();
+        }
 
         /*
          * Create a vector of queues that stores VkDeviceQueueCreateInfos. This structure describes number of queues we
@@ -694,6 +1163,10 @@ private:
          */
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+        if (indices.transferFamily.has_value())
+        {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -709,6 +1182,25 @@ private:
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE; /* turn on anisotropy mode */
 
+        /*
+         * Pipeline statistics queries are optional, --frame-stats falls back to
+         * CPU counters without them
+         */
+        VkPhysicalDeviceFeatures supportedFeatures{};
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        pipelineStatisticsEnabled = !options.frameStatistics.empty() && supportedFeatures.pipelineStatisticsQuery;
+
+        /*
+         * Secondary command buffers may only run inside the render pass's
+         * statistics query with the inheritedQueries feature
+         */
+        if (options.recordThreads > 0 && !supportedFeatures.inheritedQueries)
+        {
+            pipelineStatisticsEnabled = false;
+        }
+        deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsEnabled ? VK_TRUE : VK_FALSE;
+        deviceFeatures.inheritedQueries = pipelineStatisticsEnabled && options.recordThreads > 0 ? VK_TRUE : VK_FALSE;
+
         /*
          * Logical device info struct
          */
@@ -723,8 +1215,9 @@ private:
         /*
          * Enable device extensions
          */
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        std::vector<const char *> extensions = requiredDeviceExtensions();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers)
         {
@@ -749,6 +1242,86 @@ private:
          */
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+        if (indices.transferFamily.has_value())
+        {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+        }
+        else
+        {
+            transferQueue = graphicsQueue;
+        }
+
+        queueFamilies = indices;
+        std::cout << "Upload queue: " << (indices.transferFamily.has_value() ? "dedicated transfer queue family " + std::to_string(indices.transferFamily.value()) : std::string("graphics queue")) << std::endl;
+    }
+
+    /**
+     * Creates the device memory allocator that createBuffer() and createImage()
+     * place their resources with.
+     */
+    void createAllocator()
+    {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        memoryBackend.reset(new VulkanMemoryBackend(device));
+        allocator.reset(new DeviceAllocator(*memoryBackend, memProperties, properties.limits.bufferImageGranularity));
+    }
+
+    /**
+     * Creates the persistently mapped staging buffer that all uploads go through
+     * and the batchers that record and submit the upload commands. With a
+     * dedicated transfer queue, a second batcher on the graphics queue takes over
+     * the uploaded resources (see releaseBufferToGraphics()).
+     */
+    void createStagingRing()
+    {
+        createBuffer(options.stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingRingBuffer, stagingRingAllocation);
+
+        stagingRing.reset(new StagingRing(device, stagingRingBuffer, stagingRingAllocation.mapped, options.stagingSize));
+
+        if (queueFamilies.transferFamily.has_value())
+        {
+            uploads.reset(new UploadBatcher(device, transferQueue, transferCommandPool, *stagingRing));
+            graphicsUploads.reset(new UploadBatcher(device, graphicsQueue, commandPool, *stagingRing));
+        }
+        else
+        {
+            uploads.reset(new UploadBatcher(device, graphicsQueue, commandPool, *stagingRing));
+        }
+    }
+
+    /**
+     * Prints the allocator's block usage and fragmentation.
+     */
+    void printAllocatorStats()
+    {
+        DeviceAllocatorStats stats = allocator->stats();
+        std::cout << "Device memory: " << stats.allocationCount << " allocations in "
+                  << stats.blockCount << " blocks + " << stats.dedicatedAllocationCount << " dedicated, "
+                  << stats.bytesUsed / 1024 << " KiB used of " << stats.bytesReserved / 1024 << " KiB reserved, "
+                  << stats.bytesWasted << " bytes wasted, fragmentation " << stats.fragmentation << std::endl;
+    }
+
+    /**
+     * Prints how the startup uploads were submitted and how long the CPU was
+     * blocked waiting for them.
+     *
+     * @param uploadMilliseconds Time spent creating the static assets.
+     */
+    void printUploadStats(double uploadMilliseconds)
+    {
+        const StagingRingStats &staging = stagingRing->statistics();
+        const UploadBatcherStats &batches = uploads->statistics();
+        std::cout << "Uploads: " << staging.bytesAllocated / 1024 << " KiB staged in " << staging.allocations
+                  << " regions, " << batches.commandsRecorded << " commands in " << batches.submissions
+                  << " submissions, " << batches.waitMilliseconds << " ms waiting for the GPU, "
+                  << staging.backPressureWaits << " staging ring waits, " << uploadMilliseconds
+                  << " ms to create the static assets" << std::endl;
     }
 
     /**
@@ -841,6 +1414,29 @@ private:
         swapChainExtent = extent;
     }
 
+    /**
+     * Headless stand-in for createSwapChain(): creates one offscreen color image
+     * per frame in flight, in the format createSwapChain() prefers, and stores
+     * them as swapChainImages so that image views, framebuffers and command
+     * recording work unchanged. Frame slot i always renders into image i.
+     */
+    void createOffscreenImages()
+    {
+        swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        swapChainExtent = {options.width, options.height};
+
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < swapChainImages.size(); i++)
+        {
+            /* Transfer source so frames can be read back */
+            createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        swapChainImages[i], offscreenImageAllocations[i]);
+        }
+    }
+
     /**
      * Creates a basic image view for every image in the swap chain so that we can use them as color targets later on.
      */
@@ -910,7 +1506,8 @@ private:
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        /* Offscreen images are left ready to be copied out, as there is no presentation engine */
+        colorAttachmentResolve.finalLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         /*
          * Every subpass references one or more of attachments. We intend to use the
@@ -1040,15 +1637,51 @@ private:
     void createGraphicsPipeline()
     {
         /*
-         * Creating fragment shader and vertex shader modules
+         * Sets up the pipeline layout
          */
-        auto vertShaderCode = readFile("/Users/stevencheng/CLionProjects/VulkanTutorial/shaders/vert.spv");
-        auto fragShaderCode = readFile("/Users/stevencheng/CLionProjects/VulkanTutorial/shaders/frag.spv");
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+
+        /*
+         * The packed vertex format gets its decode ranges through push constants
+         */
+        VkPushConstantRange quantizationRange{};
+        quantizationRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        quantizationRange.offset = 0;
+        quantizationRange.size = sizeof(VertexQuantization);
+        if (options.vertexFormat == VertexFormat::Packed)
+        {
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &quantizationRange;
+        }
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        graphicsPipeline = pipelineCompiler.submit([this]()
+                                                   { return compileGraphicsPipeline(); });
+    }
+
+    /**
+     * Builds the graphics pipeline from the shaders and the fixed-function
+     * state. Runs on a pipeline compiler thread, so it only reads state that
+     * is fixed once createGraphicsPipeline() is called.
+     *
+     * @return The new pipeline.
+     */
+    VkPipeline compileGraphicsPipeline()
+    {
+        /*
+         * Creating fragment shader and vertex shader modules
+         */
+        VkShaderModule vertShaderModule = createShaderModule(findShader(options.vertexFormat == VertexFormat::Packed ? "vertQuantized" : "vert"));
+        VkShaderModule fragShaderModule = createShaderModule(findShader("frag"));
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
         vertShaderStageInfo.module = vertShaderModule;
@@ -1070,11 +1703,22 @@ private:
 
         auto bindingDescription = Vertex::getBindingDescription();
         auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        auto packedBindingDescription = PackedVertex::getBindingDescription();
+        auto packedAttributeDescriptions = PackedVertex::getAttributeDescriptions();
 
         vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        if (options.vertexFormat == VertexFormat::Packed)
+        {
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(packedAttributeDescriptions.size());
+            vertexInputInfo.pVertexBindingDescriptions = &packedBindingDescription;
+            vertexInputInfo.pVertexAttributeDescriptions = packedAttributeDescriptions.data();
+        }
+        else
+        {
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+            vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+            vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        }
 
         /*
          * Describes geometry for vertices and if primitive restart should be enabled
@@ -1164,19 +1808,6 @@ private:
         dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
         dynamicState.pDynamicStates = dynamicStates.data();
 
-        /*
-         * Sets up the pipeline layout
-         */
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
         /*
          * Initializes graphics pipeline struct
          */
@@ -1209,13 +1840,16 @@ private:
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(device, pipelineCache->handle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
 
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+        return pipeline;
     }
 
     /**
@@ -1271,6 +1905,20 @@ private:
         {
             throw std::runtime_error("failed to create graphics command pool!");
         }
+
+        if (queueFamilies.transferFamily.has_value())
+        {
+            /* Upload command buffers are recorded once and freed after they have executed */
+            VkCommandPoolCreateInfo transferPoolInfo{};
+            transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            transferPoolInfo.queueFamilyIndex = queueFamilies.transferFamily.value();
+
+            if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create transfer command pool!");
+            }
+        }
     }
 
     /**
@@ -1285,7 +1933,7 @@ private:
     {
         VkFormat colorFormat = swapChainImageFormat;
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
+        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageAllocation);
         colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
     }
 
@@ -1297,7 +1945,7 @@ private:
     {
         VkFormat depthFormat = findDepthFormat();
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageAllocation);
         depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
     }
 
@@ -1377,12 +2025,6 @@ private:
         int texWidth, texHeight, texChannels;
         stbi_uc *pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
-        /*
-         * The pixels are laid out row by row with 4 bytes per pixel in the case of
-         * STBI_rgb_alpha for a total of texWidth * texHeight * 4 values.
-         */
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-
         /*
          * Obtain miplevels based on texture image. The max function selects the largest dimension. The log2 function calculates how many times that dimension can be divided by 2. The floor function handles cases where the largest dimension is not a power of 2. 1 is added so that the original image has a mip level.
          */
@@ -1393,38 +2035,25 @@ private:
             throw std::runtime_error("failed to load texture image!");
         }
 
-        /*
-         * Create buffer in host visible memory so that we can use vkMapMemory and
-         * copy pixels to it.
-         */
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        /*
-         * Copy pixel values from image loading library to buffer
-         */
-        void *data;
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
-
-        stbi_image_free(pixels);
-
         /*
          * Create image
          */
-        createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+        createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageAllocation);
 
         /* Preparing texture image to receive data through transfer operation */
         transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
-        /* Execute the buffer to image copy operation */
-        copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+        /*
+         * Copy the pixels through the staging ring. They are laid out row by row
+         * with 4 bytes per pixel in the case of STBI_rgb_alpha.
+         */
+        uploadImage(textureImage, pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 4);
         // transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        stbi_image_free(pixels);
+
+        /* The mipmap blits need a graphics queue */
+        releaseImageToGraphics(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
         generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
     }
@@ -1464,7 +2093,7 @@ private:
             throw std::runtime_error("texture image format does not support linear blitting!");
         }
 
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginGraphicsUploadCommands();
 
         /*
          * There are several transitions, so we will reuse the VkImageMemoryBarrier
@@ -1578,7 +2207,7 @@ private:
 
         vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-        endSingleTimeCommands(commandBuffer);
+        endUploadCommands();
     }
 
     /**
@@ -1750,8 +2379,8 @@ private:
      * This function creates a 2D Vulkan image with the given width, height, format,
      * tiling, usage, and memory properties. It sets the necessary parameters in the
      * VkImageCreateInfo struct and creates the image using vkCreateImage(). Memory
-     * for the image is allocated using vkAllocateMemory(), and the image is bound
-     * to the allocated memory using vkBindImageMemory().
+     * for the image is sub-allocated from the device allocator, and the image is
+     * bound to its range using vkBindImageMemory().
      *
      * @param width The width of the image in pixels.
      * @param height The height of the image in pixels.
@@ -1760,10 +2389,10 @@ private:
      * @param usage The intended usage of the image.
      * @param properties The memory properties for the allocated image memory.
      * @param image [out] Reference to the created Vulkan image object.
-     * @param imageMemory [out] Reference to the allocated Vulkan device memory for the image.
+     * @param imageAllocation [out] Reference to the device memory allocation for the image.
      * @throws std::runtime_error if the image creation or memory allocation fails.
      */
-    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory)
+    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, DeviceAllocation &imageAllocation)
     {
         /*
          * This code initializes a Vulkan image creation struct and sets its
@@ -1802,22 +2431,15 @@ private:
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to allocate image memory!");
-        }
+        DeviceResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? DeviceResourceKind::Optimal : DeviceResourceKind::Linear;
+        imageAllocation = allocator->allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), kind);
 
-        vkBindImageMemory(device, image, imageMemory, 0);
+        vkBindImageMemory(device, image, imageAllocation.memory, imageAllocation.offset);
     }
 
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
     {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginUploadCommands();
 
         /*
          * Use an image memory barrier to transition image layouts and transfer
@@ -1886,35 +2508,36 @@ private:
             0, nullptr,
             1, &barrier);
 
-        endSingleTimeCommands(commandBuffer);
+        endUploadCommands();
     }
 
     /*
      * This function copies data from the specified Vulkan buffer to the specified
-     * Vulkan image. It begins a single-use command buffer, sets up a
-     * buffer-to-image copy region, and performs the copy operation using
-     * vkCmdCopyBufferToImage(). The command buffer is then ended and submitted for
-     * execution. The copy operation transfers the data to the image with the
-     * specified layout and applies the provided width and height to the copy region.
+     * Vulkan image. It sets up a buffer-to-image copy region and records the copy
+     * operation using vkCmdCopyBufferToImage() into the open upload batch. The copy
+     * operation transfers the data to the image with the specified layout and
+     * applies the provided width and height to the copy region.
      *
      * @param buffer The Vulkan buffer containing the data to be copied.
      * @param image The Vulkan image to which the data will be copied.
      * @param width The width of the image data to be copied.
      * @param height The height of the image data to be copied.
+     * @param bufferOffset Byte offset of the data in 'buffer'.
+     * @param firstRow First image row written by the copy.
      */
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDeviceSize bufferOffset = 0, uint32_t firstRow = 0)
     {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginUploadCommands();
 
         VkBufferImageCopy region{};
-        region.bufferOffset = 0; /* byte offset */
+        region.bufferOffset = bufferOffset; /* byte offset */
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         region.imageSubresource.mipLevel = 0;
         region.imageSubresource.baseArrayLayer = 0;
         region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
+        region.imageOffset = {0, static_cast<int32_t>(firstRow), 0};
         region.imageExtent = {
             width,
             height,
@@ -1922,7 +2545,277 @@ private:
 
         vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-        endSingleTimeCommands(commandBuffer);
+        endUploadCommands();
+    }
+
+    /**
+     * Uploads tightly packed pixels to mip level 0 of an image in
+     * VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL through the staging ring. Images larger
+     * than half the ring are copied in bands of rows.
+     *
+     * @param image The image to fill.
+     * @param pixels Row-major pixel data.
+     * @param width The width of the image in pixels.
+     * @param height The height of the image in pixels.
+     * @param texelSize Bytes per pixel.
+     */
+    void uploadImage(VkImage image, const void *pixels, uint32_t width, uint32_t height, uint32_t texelSize)
+    {
+        VkDeviceSize rowPitch = static_cast<VkDeviceSize>(width) * texelSize;
+        uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(1, stagingRing->capacity() / 2 / rowPitch));
+
+        for (uint32_t row = 0; row < height; row += rowsPerChunk)
+        {
+            uint32_t rows = std::min(rowsPerChunk, height - row);
+            StagingRegion region = uploads->stage(rows * rowPitch);
+            memcpy(region.data, static_cast<const char *>(pixels) + row * rowPitch, static_cast<size_t>(rows * rowPitch));
+            copyBufferToImage(region.buffer, image, width, rows, region.offset, row);
+        }
+    }
+
+    /**
+     * Loads the model into the 'vertices' and 'indices' vectors.
+     * The binary mesh cache is tried first; on a miss (no cache yet, or the OBJ
+     * changed since it was written) the OBJ is parsed, optionally optimized, and the
+     * cache is rewritten for the next launch. Reports how long the load took either way.
+     */
+    void loadModel()
+    {
+        if (options.verifyLoader)
+        {
+            verifyModelLoaders();
+        }
+
+        uint32_t cacheFlags = options.optimizeMesh ? MESH_CACHE_FLAG_OPTIMIZED : 0;
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        if (loadMeshCache(MODEL_CACHE_PATH, MODEL_PATH, cacheFlags, vertices, indices))
+        {
+            auto hitTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+            std::cout << "Loaded " << MODEL_PATH << " from mesh cache in " << hitTime << " ms ("
+                      << vertices.size() << " vertices, " << indices.size() << " indices)" << std::endl;
+            return;
+        }
+
+        vertices.clear();
+        indices.clear();
+        if (options.loaderThreads == 1 || !parseModelParallel(options.loaderThreads, vertices, indices))
+        {
+            parseModel(vertices, indices);
+        }
+
+        auto parseTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Parsed " << MODEL_PATH << " in " << parseTime << " ms ("
+                  << vertices.size() << " vertices, " << indices.size() << " indices)" << std::endl;
+
+        if (options.optimizeMesh)
+        {
+            optimizeModel();
+        }
+
+        if (!writeMeshCache(MODEL_CACHE_PATH, MODEL_PATH, cacheFlags, vertices, indices))
+        {
+            std::cerr << "failed to write mesh cache " << MODEL_CACHE_PATH << std::endl;
+        }
+    }
+
+    /**
+     * Reorders the triangles of the model for post-transform vertex cache reuse,
+     * then the vertices in order of first use for vertex fetch locality, and prints
+     * the simulated cache efficiency before and after.
+     */
+    void optimizeModel()
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        VertexCacheStatistics before = analyzeVertexCache(indices, vertices.size());
+
+        optimizeVertexCache(indices, vertices.size());
+        optimizeVertexFetch(vertices, indices);
+
+        VertexCacheStatistics after = analyzeVertexCache(indices, vertices.size());
+        auto optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+        std::cout << "Optimized mesh in " << optimizeTime << " ms (cache size " << MESH_OPTIMIZER_CACHE_SIZE << "): "
+                  << "ACMR " << before.acmr << " -> " << after.acmr << ", "
+                  << "ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+
+    /**
+     * Prepares the index data for drawing. With 16-bit indices the model is split into
+     * chunks of at most 65536 vertices, each drawn with its own vertexOffset; the
+     * 32-bit 'indices' are replaced by 'indices16'. With 32-bit indices the whole
+     * model is a single chunk.
+     */
+    void splitModel()
+    {
+        if (options.indexType == VK_INDEX_TYPE_UINT32)
+        {
+            meshChunks = {{0, static_cast<uint32_t>(indices.size()), 0, static_cast<uint32_t>(vertices.size())}};
+            return;
+        }
+
+        size_t originalVertexCount = vertices.size();
+        std::vector<Vertex> splitVertices;
+        splitMesh16(vertices, indices, splitVertices, indices16, meshChunks);
+        vertices.swap(splitVertices);
+
+        std::cout << "16-bit index buffer: " << meshChunks.size() << " chunk(s), "
+                  << sizeof(uint16_t) * indices16.size() / 1024 << " KB instead of " << sizeof(uint32_t) * indices.size() / 1024 << " KB, "
+                  << vertices.size() - originalVertexCount << " vertices duplicated across chunks" << std::endl;
+
+        indices.clear();
+        indices.shrink_to_fit();
+    }
+
+    /**
+     * Converts the loaded vertices to PackedVertex when the packed vertex format is
+     * selected, and reports the memory saved and the largest decode error. Does
+     * nothing for the float format.
+     */
+    void quantizeModel()
+    {
+        if (options.vertexFormat != VertexFormat::Packed)
+        {
+            return;
+        }
+
+        glm::vec3 positionMin(std::numeric_limits<float>::max());
+        glm::vec3 positionMax(-std::numeric_limits<float>::max());
+        glm::vec2 texCoordMin(std::numeric_limits<float>::max());
+        glm::vec2 texCoordMax(-std::numeric_limits<float>::max());
+        for (const Vertex &vertex : vertices)
+        {
+            positionMin = glm::min(positionMin, vertex.pos);
+            positionMax = glm::max(positionMax, vertex.pos);
+            texCoordMin = glm::min(texCoordMin, vertex.texCoord);
+            texCoordMax = glm::max(texCoordMax, vertex.texCoord);
+
+            if (vertex.color != vertices[0].color)
+            {
+                throw std::runtime_error("packed vertex format requires a constant vertex color!");
+            }
+        }
+
+        glm::vec3 positionScale = positionMax - positionMin;
+        glm::vec2 texCoordScale = texCoordMax - texCoordMin;
+
+        vertexQuantization.positionOffset = glm::vec4(positionMin, 0.0f);
+        vertexQuantization.positionScale = glm::vec4(positionScale, 0.0f);
+        vertexQuantization.texCoordOffsetScale = glm::vec4(texCoordMin.x, texCoordMin.y, texCoordScale.x, texCoordScale.y);
+        vertexQuantization.color = glm::vec4(vertices.empty() ? glm::vec3(1.0f) : vertices[0].color, 1.0f);
+
+        /*
+         * Round to the nearest of the 65536 steps, exactly what UNORM decodes back to.
+         */
+        auto encode = [](float value, float offset, float scale) -> uint16_t
+        {
+            float normalized = scale > 0.0f ? (value - offset) / scale : 0.0f;
+            normalized = std::min(std::max(normalized, 0.0f), 1.0f);
+            return static_cast<uint16_t>(normalized * 65535.0f + 0.5f);
+        };
+        auto decode = [](uint16_t value, float offset, float scale)
+        {
+            return offset + (value / 65535.0f) * scale;
+        };
+
+        float maxPositionError = 0.0f;
+        float maxTexCoordError = 0.0f;
+        packedVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            PackedVertex &packed = packedVertices[i];
+
+            for (int c = 0; c < 3; c++)
+            {
+                packed.pos[c] = encode(vertex.pos[c], positionMin[c], positionScale[c]);
+                maxPositionError = std::max(maxPositionError, std::abs(decode(packed.pos[c], positionMin[c], positionScale[c]) - vertex.pos[c]));
+            }
+            packed.pos[3] = 0;
+
+            for (int c = 0; c < 2; c++)
+            {
+                packed.texCoord[c] = encode(vertex.texCoord[c], texCoordMin[c], texCoordScale[c]);
+                maxTexCoordError = std::max(maxTexCoordError, std::abs(decode(packed.texCoord[c], texCoordMin[c], texCoordScale[c]) - vertex.texCoord[c]));
+            }
+        }
+
+        float extent = std::max(positionScale.x, std::max(positionScale.y, positionScale.z));
+        std::cout << "Packed vertex format: " << sizeof(PackedVertex) << " bytes/vertex (float: " << sizeof(Vertex) << "), "
+                  << sizeof(PackedVertex) * packedVertices.size() / 1024 << " KB instead of " << sizeof(Vertex) * vertices.size() / 1024 << " KB, "
+                  << "max position error " << maxPositionError << " (" << (extent > 0.0f ? 100.0f * maxPositionError / extent : 0.0f) << "% of extent), "
+                  << "max UV error " << maxTexCoordError << std::endl;
+    }
+
+    /**
+     * Builds a model vertex from an OBJ position and texture coordinate. Shared by
+     * the serial and the parallel loader so both produce identical vertices.
+     *
+     * @param position Pointer to the x, y, z position.
+     * @param texCoord Pointer to the u, v texture coordinate.
+     * @return The vertex.
+     */
+    static Vertex makeModelVertex(const tinyobj::real_t *position, const tinyobj::real_t *texCoord)
+    {
+        Vertex vertex{};
+
+        vertex.pos = {position[0], position[1], position[2]};
+
+        /*
+         * The OBJ format assumes a coordinate system where a vertical
+         * coordinate of 0 means the bottom of the image, however we've
+         * uploaded our image into Vulkan in a top to bottom orientation
+         * where 0 means the top of the image.
+         */
+        vertex.texCoord = {texCoord[0], 1.0f - texCoord[1]};
+
+        vertex.color = {1.0f, 1.0f, 1.0f};
+
+        return vertex;
+    }
+
+    /**
+     * Parses the model with the multi-threaded OBJ loader.
+     *
+     * @param threadCount Number of threads, 0 for one per hardware thread.
+     * @param outVertices Receives the unique vertices.
+     * @param outIndices Receives the indices.
+     * @return false if the model needs the serial loader (polygons with more than four corners).
+     */
+    bool parseModelParallel(unsigned threadCount, std::vector<Vertex> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        ObjParallelLoader<Vertex> loader(threadCount);
+        return loader.load(MODEL_PATH, makeModelVertex, outVertices, outIndices);
+    }
+
+    /**
+     * Loads the model with both the serial and the parallel loader and checks that
+     * the results are bit-identical. Throws if they differ.
+     */
+    void verifyModelLoaders()
+    {
+        std::vector<Vertex> serialVertices;
+        std::vector<uint32_t> serialIndices;
+        parseModel(serialVertices, serialIndices);
+
+        std::vector<Vertex> parallelVertices;
+        std::vector<uint32_t> parallelIndices;
+        if (!parseModelParallel(options.loaderThreads, parallelVertices, parallelIndices))
+        {
+            std::cout << "Parallel OBJ loader not applicable to " << MODEL_PATH << ", serial loader is used" << std::endl;
+            return;
+        }
+
+        bool identical = serialIndices == parallelIndices &&
+                         serialVertices.size() == parallelVertices.size() &&
+                         std::memcmp(serialVertices.data(), parallelVertices.data(), sizeof(Vertex) * serialVertices.size()) == 0;
+        if (!identical)
+        {
+            throw std::runtime_error("parallel OBJ loader output differs from the serial loader!");
+        }
+
+        std::cout << "Parallel OBJ loader output matches the serial loader ("
+                  << serialVertices.size() << " vertices, " << serialIndices.size() << " indices)" << std::endl;
     }
 
     /**
@@ -1930,10 +2823,11 @@ private:
      * extracts vertex positions, texture coordinates, and indices. Vertex
      * deduplication is performed to eliminate duplicated vertices, ensuring
      * efficient memory usage.
-     * The resulting unique vertices are stored in the 'vertices' vector, and the
-     * indices for rendering are stored in the 'indices' vector.
+     *
+     * @param outVertices Receives the unique vertices.
+     * @param outIndices Receives the indices for rendering.
      */
-    void loadModel()
+    void parseModel(std::vector<Vertex> &outVertices, std::vector<uint32_t> &outIndices)
     {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
@@ -1945,7 +2839,18 @@ private:
             throw std::runtime_error(warn + err);
         }
 
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        /*
+         * Every OBJ position is used by at least one unique vertex, which makes
+         * the position count a good initial size for the welder.
+         */
+        size_t cornerCount = 0;
+        for (const auto &shape : shapes)
+        {
+            cornerCount += shape.mesh.indices.size();
+        }
+        VertexWelder<Vertex> welder(attrib.vertices.size() / 3);
+        outVertices.reserve(attrib.vertices.size() / 3);
+        outIndices.reserve(cornerCount);
 
         for (const auto &shape : shapes)
         {
@@ -1954,132 +2859,90 @@ private:
                 /*
                  * Create a Vertex object for every row of data in the obj file.
                  */
-                Vertex vertex{};
-
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]};
-
-                /*
-                 * The OBJ format assumes a coordinate system where a vertical
-                 * coordinate of 0 means the bottom of the image, however we've
-                 * uploaded our image into Vulkan in a top to bottom orientation
-                 * where 0 means the top of the image.
-                 */
-                vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
-
-                vertex.color = {1.0f, 1.0f, 1.0f};
+                Vertex vertex = makeModelVertex(&attrib.vertices[3 * index.vertex_index],
+                                                &attrib.texcoords[2 * index.texcoord_index]);
 
                 /*
                  * Vertex deduplication
                  */
-                if (uniqueVertices.count(vertex) == 0)
-                {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-
-                indices.push_back(uniqueVertices[vertex]);
+                outIndices.push_back(welder.weld(vertex, outVertices));
             }
         }
     }
 
     /**
      * Creates a vertex buffer for storing vertex data in Vulkan.
-     * The vertex buffer is created using a staging buffer and transfer operations.
+     * The vertex buffer is filled through the staging ring with transfer operations.
      *
      * The method performs the following steps:
      * 1. Calculates the required buffer size based on the vertex data size.
-     * 2. Creates a staging buffer in host-visible and host-coherent memory properties,
-     *    which allows for efficient data transfer from CPU to GPU.
-     * 3. Maps the staging buffer memory and copies the vertex data into it.
-     * 4. Unmaps the staging buffer memory.
-     * 5. Creates the final vertex buffer in device-local memory,
+     * 2. Creates the final vertex buffer in device-local memory,
      *    which provides optimal performance for GPU access.
-     * 6. Performs a buffer-to-buffer copy operation to transfer the data from the staging buffer to the vertex buffer.
-     * 7. Destroys the staging buffer and frees its associated memory.
+     * 3. Copies the vertex data into the persistently mapped staging ring and transfers
+     *    it to the vertex buffer with buffer-to-buffer copies (see uploadBuffer()).
      */
     void createVertexBuffer()
     {
+        const void *vertexData = vertices.data();
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+        if (options.vertexFormat == VertexFormat::Packed)
+        {
+            vertexData = packedVertices.data();
+            bufferSize = sizeof(packedVertices[0]) * packedVertices.size();
+        }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        uploadBuffer(vertexBuffer, vertexData, bufferSize);
     }
 
     /**
      * Creates an index buffer for storing index data in Vulkan.
-     * The index buffer is created using a staging buffer and transfer operations.
+     * The index buffer is filled through the staging ring with transfer operations.
      *
      * The method performs the following steps:
      * 1. Calculates the required buffer size based on the index data size.
-     * 2. Creates a staging buffer in host-visible and host-coherent memory properties,
-     *    which allows for efficient data transfer from CPU to GPU.
-     * 3. Maps the staging buffer memory and copies the index data into it.
-     * 4. Unmaps the staging buffer memory.
-     * 5. Creates the final index buffer in device-local memory,
+     * 2. Creates the final index buffer in device-local memory,
      *    which provides optimal performance for GPU access.
-     * 6. Performs a buffer-to-buffer copy operation to transfer the data from the staging buffer to the index buffer.
-     * 7. Destroys the staging buffer and frees its associated memory.
+     * 3. Copies the index data into the persistently mapped staging ring and transfers
+     *    it to the index buffer with buffer-to-buffer copies (see uploadBuffer()).
      */
     void createIndexBuffer()
     {
+        const void *indexData = indices.data();
         VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        if (options.indexType == VK_INDEX_TYPE_UINT16)
+        {
+            indexData = indices16.data();
+            bufferSize = sizeof(indices16[0]) * indices16.size();
+        }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-
-        copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        uploadBuffer(indexBuffer, indexData, bufferSize);
     }
 
     /**
      * This method creates uniform buffers for each frame in flight, based on the `MAX_FRAMES_IN_FLIGHT` constant.
      * The buffer size is determined by the size of the `UniformBufferObject` structure.
-     * The method resizes the `uniformBuffers`, `uniformBuffersMemory`, and `uniformBuffersMapped` vectors to accommodate the buffers for each frame.
+     * The method resizes the `uniformBuffers`, `uniformBuffersAllocations`, and `uniformBuffersMapped` vectors to accommodate the buffers for each frame.
      * It then iterates over each frame and calls the `createBuffer` function to create the uniform buffer,
      * specifying the buffer size, usage flags, and memory properties.
-     * Finally, it maps the memory of each uniform buffer for host visibility and coherence.
+     * The allocator keeps host-visible memory mapped, so the mapped pointers are taken from the allocations.
      */
     void createUniformBuffers()
     {
         VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
         uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersAllocations.resize(MAX_FRAMES_IN_FLIGHT);
         uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersAllocations[i]);
 
-            vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+            uniformBuffersMapped[i] = uniformBuffersAllocations[i].mapped;
         }
     }
 
@@ -2193,9 +3056,10 @@ private:
      * @param usage The usage flags specifying how the buffer will be used.
      * @param properties The memory property flags defining the desired memory properties for the buffer.
      * @param buffer Reference to a VkBuffer variable to store the created buffer handle.
-     * @param bufferMemory Reference to a VkDeviceMemory variable to store the allocated device memory for the buffer.
+     * @param bufferAllocation Reference to a DeviceAllocation variable to store the buffer's memory range.
+     *        For host-visible memory its 'mapped' member points at the buffer contents.
      */
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, DeviceAllocation &bufferAllocation)
     {
         /*
          * Define class member to hold the buffer handle
@@ -2212,111 +3076,193 @@ private:
         }
 
         /*
-         * Determine the right memory type for the buffer and allocate memory
+         * Determine the right memory type for the buffer and sub-allocate memory
          */
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to allocate buffer memory!");
-        }
+        bufferAllocation = allocator->allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), DeviceResourceKind::Linear);
 
         /*
-         * Associate memory with the buffer, fill the vertex buffer, then
-         * unmaps the memory allocated for the buffer.
+         * Associate the allocated range with the buffer
          */
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        vkBindBufferMemory(device, buffer, bufferAllocation.memory, bufferAllocation.offset);
     }
 
     /**
-     * This function allocates a temporary command buffer for a single-use transfer
-     * operation. It creates a command buffer using vkAllocateCommandBuffers() with
-     * the specified command pool, level, and count. The command buffer is then
-     * started for recording using vkBeginCommandBuffer() with the
-     * VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT flag set. The created command
-     * buffer is returned for further use.
+     * Returns the command buffer that upload commands (copies, layout transitions,
+     * mipmap blits) are recorded into. Consecutive upload commands share one
+     * batch, which is submitted by submitUploads() or when the staging ring needs
+     * to be recycled.
      *
-     * @returns The allocated command buffer for immediate execution.
+     * @returns The open upload command buffer.
      */
-    VkCommandBuffer beginSingleTimeCommands()
+    VkCommandBuffer beginUploadCommands()
     {
-        /*
-         * Allocate temporary command buffer for transfer
-         */
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
+        return uploads->record();
+    }
 
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+    /**
+     * Like beginUploadCommands(), for upload commands that need a graphics queue,
+     * such as blits. They are ordered after the commands recorded with
+     * beginUploadCommands() so far, and only see resources that were handed over
+     * with releaseBufferToGraphics() or releaseImageToGraphics().
+     *
+     * @returns The open graphics upload command buffer.
+     */
+    VkCommandBuffer beginGraphicsUploadCommands()
+    {
+        return graphicsUploads ? graphicsUploads->record() : uploads->record();
+    }
 
-        /*
-         * Start recording command buffer
-         */
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    /**
+     * Ends an upload command. With --immediate-uploads each command is submitted
+     * on its own and waited for, as uploads used to be done; otherwise it stays
+     * in the open batch.
+     */
+    void endUploadCommands()
+    {
+        if (options.immediateUploads)
+        {
+            uploads->wait(submitUploads());
+        }
+    }
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    /**
+     * Hands a buffer written by upload commands over from the transfer queue
+     * family to the graphics queue family. Without a dedicated transfer queue
+     * both are the same and nothing needs to be done.
+     */
+    void releaseBufferToGraphics(VkBuffer buffer)
+    {
+        if (!graphicsUploads)
+        {
+            return;
+        }
 
-        return commandBuffer;
+        uint32_t transferFamily = queueFamilies.transferFamily.value();
+        uint32_t graphicsFamily = queueFamilies.graphicsFamily.value();
+        recordBufferOwnershipTransfer(uploads->record(), buffer, transferFamily, graphicsFamily, true);
+        recordBufferOwnershipTransfer(graphicsUploads->record(), buffer, transferFamily, graphicsFamily, false);
+        endUploadCommands();
     }
 
     /**
-     * This function ends the specified command buffer using vkEndCommandBuffer().
-     * It then creates a submit info structure and submits the command buffer for
-     * execution immediately. The command buffer is submitted to the graphics queue
-     * specified by 'graphicsQueue'. After the execution completes, vkQueueWaitIdle
-     * () is called to wait until all submitted work is finished. Finally, the
-     * command buffer is freed using vkFreeCommandBuffers().
+     * Image counterpart of releaseBufferToGraphics().
      *
-     * @param commandBuffer The command buffer to end and submit.
+     * @param layout Layout of all mip levels of the image, kept by the handover.
+     * @param mipLevels Number of mip levels of the image.
      */
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer)
+    void releaseImageToGraphics(VkImage image, VkImageLayout layout, uint32_t mipLevels)
     {
-        vkEndCommandBuffer(commandBuffer);
-
-        /*
-         * Create queue info and execute the transfer on the buffers immediately
-         */
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
+        if (!graphicsUploads)
+        {
+            return;
+        }
 
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        uint32_t transferFamily = queueFamilies.transferFamily.value();
+        uint32_t graphicsFamily = queueFamilies.graphicsFamily.value();
+        recordImageOwnershipTransfer(uploads->record(), image, layout, mipLevels, transferFamily, graphicsFamily, true);
+        recordImageOwnershipTransfer(graphicsUploads->record(), image, layout, mipLevels, transferFamily, graphicsFamily, false);
+        endUploadCommands();
     }
 
     /**
-     * Copies data from the source buffer to the destination buffer using Vulkan commands.
+     * Submits all recorded upload commands without waiting for them. Commands
+     * submitted later on the graphics queue see the uploaded data.
      *
-     * @param srcBuffer The source buffer from which data will be copied.
-     * @param dstBuffer The destination buffer where data will be copied to.
-     * @param size The size of the data to be copied in bytes.
+     * With a dedicated transfer queue the transfer batch signals a semaphore
+     * that the graphics batch, holding the ownership acquires, waits for; the
+     * graphics queue only stalls at that point, not during the copies.
+     *
+     * @returns Token to poll or wait for the uploads' completion.
      */
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+    UploadToken submitUploads()
     {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        recycleUploadSemaphores(false);
+
+        if (!graphicsUploads || graphicsUploads->empty())
+        {
+            return uploads->submit();
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkSemaphore transferDone;
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &transferDone) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload semaphore!");
+        }
+
+        uploads->submit(transferDone);
+        UploadToken token = graphicsUploads->submit(VK_NULL_HANDLE, transferDone, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        uploadSemaphores.push_back(std::make_pair(token, transferDone));
+        return token;
+    }
+
+    /**
+     * Destroys the semaphores of transfer to graphics handoffs whose graphics
+     * batch has finished.
+     *
+     * @param all Wait for and destroy all of them, at shutdown.
+     */
+    void recycleUploadSemaphores(bool all)
+    {
+        while (!uploadSemaphores.empty() && (all || stagingRing->isComplete(uploadSemaphores.front().first)))
+        {
+            stagingRing->wait(uploadSemaphores.front().first);
+            vkDestroySemaphore(device, uploadSemaphores.front().second, nullptr);
+            uploadSemaphores.pop_front();
+        }
+    }
+
+    /**
+     * Copies data from the source buffer to the destination buffer using Vulkan commands.
+     *
+     * @param srcBuffer The source buffer from which data will be copied.
+     * @param dstBuffer The destination buffer where data will be copied to.
+     * @param size The size of the data to be copied in bytes.
+     * @param srcOffset Byte offset of the data in the source buffer.
+     * @param dstOffset Byte offset the data is written to in the destination buffer.
+     */
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0)
+    {
+        VkCommandBuffer commandBuffer = beginUploadCommands();
 
         /*
          * Contents of buffer are transferred
          */
         VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-        endSingleTimeCommands(commandBuffer);
+        endUploadCommands();
+    }
+
+    /**
+     * Copies host data into a buffer through the staging ring. Data larger than
+     * half the ring is split into several copies.
+     *
+     * @param dstBuffer The buffer to fill, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+     * @param data The data to upload.
+     * @param size The size of the data in bytes.
+     */
+    void uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size)
+    {
+        VkDeviceSize chunkSize = stagingRing->capacity() / 2;
+
+        for (VkDeviceSize offset = 0; offset < size; offset += chunkSize)
+        {
+            VkDeviceSize bytes = std::min(chunkSize, size - offset);
+            StagingRegion region = uploads->stage(bytes);
+            memcpy(region.data, static_cast<const char *>(data) + offset, static_cast<size_t>(bytes));
+            copyBuffer(region.buffer, dstBuffer, bytes, region.offset, offset);
+        }
+
+        releaseBufferToGraphics(dstBuffer);
     }
 
     /**
@@ -2372,6 +3318,180 @@ private:
         }
     }
 
+    /**
+     * Starts the --record-threads recording threads, each with a command pool
+     * per frame in flight.
+     */
+    void createCommandRecorder()
+    {
+        if (options.recordThreads == 0)
+        {
+            return;
+        }
+
+        commandRecorder.reset(new ParallelCommandRecorder(device, queueFamilies.graphicsFamily.value(), options.recordThreads, MAX_FRAMES_IN_FLIGHT));
+        recorderCommandCounters.resize(commandRecorder->threadCount());
+    }
+
+    /**
+     * Allocates and records the command buffers of --static-command-buffers: one
+     * for each pair of framebuffer and frame in flight. A buffer binds the
+     * descriptor set of its frame slot, so the uniform buffer that drawFrame()
+     * writes is the only data that changes between frames, and nothing needs to
+     * be recorded again until the swap chain is recreated.
+     *
+     * Called from drawFrame() when the buffers are missing rather than from
+     * initVulkan(), so recording waits for the background pipeline compile only
+     * when the first frame needs it.
+     */
+    void recordStaticCommandBuffers()
+    {
+        staticCommandBuffers.resize(swapChainFramebuffers.size() * MAX_FRAMES_IN_FLIGHT);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = (uint32_t)staticCommandBuffers.size();
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, staticCommandBuffers.data()) != VK_SUCCESS)
+        {
+            staticCommandBuffers.clear();
+            throw std::runtime_error("failed to allocate static command buffers!");
+        }
+
+        for (uint32_t image = 0; image < swapChainFramebuffers.size(); image++)
+        {
+            for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+            {
+                recordCommandBuffer(staticCommandBuffers[image * MAX_FRAMES_IN_FLIGHT + frame], image, frame);
+            }
+        }
+    }
+
+    /**
+     * Frees the static command buffers so they are recorded again for new
+     * framebuffers. The device must be idle.
+     */
+    void freeStaticCommandBuffers()
+    {
+        if (staticCommandBuffers.empty())
+        {
+            return;
+        }
+
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(staticCommandBuffers.size()), staticCommandBuffers.data());
+        staticCommandBuffers.clear();
+    }
+
+    /**
+     * Records the state every draw of the frame needs: pipeline, viewport,
+     * scissor, vertex and index buffers, descriptor set and push constants.
+     * Secondary command buffers inherit none of it, so each records it again.
+     *
+     * @param counters Counters of the recording thread.
+     */
+    void recordDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t frame, CommandCounters &counters)
+    {
+        /*
+         * Bind graphics pipeline by specifying pipeline is a graphics one.
+         * Then, specify viewport and scissor state for this pipeline to be dynamic.
+         */
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        counters.pipelineBinds++;
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)swapChainExtent.width;
+        viewport.height = (float)swapChainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        VkBuffer vertexBuffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        uint32_t firstBinding = 0;
+        uint32_t bindingCount = 1;
+        vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, vertexBuffers, offsets);
+
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, options.indexType);
+        counters.bufferBinds += 2;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+        counters.descriptorSetBinds++;
+
+        if (options.vertexFormat == VertexFormat::Packed)
+        {
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexQuantization), &vertexQuantization);
+        }
+    }
+
+    /**
+     * @return Draws per frame: one per mesh chunk, times --draw-repeat.
+     */
+    size_t drawCount() const
+    {
+        return meshChunks.size() * options.drawRepeat;
+    }
+
+    /**
+     * Records the draws [first, last) of the frame. Draw i renders mesh chunk
+     * i % meshChunks.size(), so --draw-repeat draws the whole model again and
+     * again on top of itself.
+     *
+     * @param counters Counters of the recording thread.
+     */
+    void recordDraws(VkCommandBuffer commandBuffer, size_t first, size_t last, CommandCounters &counters)
+    {
+        /*
+         * One draw per chunk; chunk indices are relative to the chunk's first vertex.
+         */
+        uint32_t instanceCount = 1;
+        uint32_t firstInstance = 0;
+        for (size_t i = first; i < last; i++)
+        {
+            const MeshChunk &chunk = meshChunks[i % meshChunks.size()];
+            vkCmdDrawIndexed(commandBuffer, chunk.indexCount, instanceCount, chunk.firstIndex, chunk.vertexOffset, firstInstance);
+        }
+        counters.draws += last - first;
+    }
+
+    /**
+     * Records the frame's draws on the --record-threads threads and executes
+     * the resulting secondary command buffers in the render pass that
+     * 'commandBuffer' has begun.
+     */
+    void recordSecondaryCommandBuffers(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t imageIndex, uint32_t frame)
+    {
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        inheritanceInfo.pipelineStatistics = pipelineStatisticsEnabled ? PIPELINE_STATISTIC_FLAGS : 0;
+
+        std::fill(recorderCommandCounters.begin(), recorderCommandCounters.end(), CommandCounters());
+
+        const std::vector<VkCommandBuffer> &secondaryCommandBuffers = commandRecorder->record(
+            frame, inheritanceInfo, drawCount(), [this, pipeline, frame](VkCommandBuffer secondary, unsigned thread, size_t first, size_t last)
+            {
+                recordDrawState(secondary, pipeline, frame, recorderCommandCounters[thread]);
+                recordDraws(secondary, first, last, recorderCommandCounters[thread]); });
+
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+
+        for (const CommandCounters &counters : recorderCommandCounters)
+        {
+            commandCounters += counters;
+        }
+    }
+
     /**
      * Responsible for recording commands into a specified command buffer in Vulkan. This is a critical step in the
      * graphics pipeline as it defines the sequence of operations to be executed by the GPU for rendering.
@@ -2380,8 +3500,12 @@ private:
      * and specifies viewport and scissor settings. The code includes a draw command to define the rendering
      * parameters. Finally, the render pass is ended, and the command buffer recording is completed. This process
      * establishes the sequence of operations to be executed by the GPU for rendering a frame in Vulkan.
+     *
+     * @param commandBuffer Command buffer to record into.
+     * @param imageIndex Framebuffer to render to.
+     * @param frame Frame in flight whose descriptor set and query slots the commands use.
      */
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frame)
     {
         /*
          * Initialize command buffer
@@ -2416,45 +3540,43 @@ private:
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (gpuTimer)
+        {
+            gpuTimer->begin(commandBuffer, frame, GPU_SCOPE_RENDER_PASS);
+        }
+        if (frameStatistics)
+        {
+            frameStatistics->begin(commandBuffer, frame, GPU_SCOPE_RENDER_PASS);
+        }
 
         /*
-         * Bind graphics pipeline by specifying pipeline is a graphics one.
-         * Then, specify viewport and scissor state for this pipeline to be dynamic.
+         * With --record-threads the draws are recorded into secondary command
+         * buffers, which the render pass then executes
          */
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapChainExtent.width;
-        viewport.height = (float)swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-        VkBuffer vertexBuffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        uint32_t firstBinding = 0;
-        uint32_t bindingCount = 1;
-        vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, vertexBuffers, offsets);
-
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        VkPipeline pipeline = graphicsPipeline.get();
+        if (commandRecorder)
+        {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recordSecondaryCommandBuffers(commandBuffer, pipeline, imageIndex, frame);
+        }
+        else
+        {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordDrawState(commandBuffer, pipeline, frame, commandCounters);
+            recordDraws(commandBuffer, 0, drawCount(), commandCounters);
+        }
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        vkCmdEndRenderPass(commandBuffer);
 
-        uint32_t instanceCount = 1;
-        uint32_t firstIndex = 0;
-        uint32_t vertexOffset = 0;
-        uint32_t firstInstance = 0;
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), instanceCount, firstIndex, vertexOffset, firstInstance);
+        if (frameStatistics)
+        {
+            frameStatistics->end(commandBuffer, frame, GPU_SCOPE_RENDER_PASS);
+        }
 
-        vkCmdEndRenderPass(commandBuffer);
+        if (gpuTimer)
+        {
+            gpuTimer->end(commandBuffer, frame, GPU_SCOPE_RENDER_PASS);
+        }
 
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
@@ -2563,6 +3685,11 @@ private:
      */
     void drawFrame()
     {
+        if (gpuTimer)
+        {
+            gpuTimer->nextFrame();
+        }
+
         /*
          * Wait for the fences to be signaled before proceeding.
          * Acquire the next image from the swap chain.
@@ -2571,33 +3698,58 @@ private:
          * Reset the fence for next frame.
          */
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        profiler.mark(FramePhase::FenceWait);
 
         uint32_t imageIndex;
-        /*
-         * Acquire next image from swap chain
-         */
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
-                                                imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        if (options.headless)
         {
-            recreateSwapChain();
-            return;
+            /* The offscreen image of this frame slot was released by the fence above */
+            imageIndex = currentFrame;
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        else
         {
-            throw std::runtime_error("failed to acquire swap chain image!");
+            /*
+             * Acquire next image from swap chain
+             */
+            VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
+                                                    imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreateSwapChain();
+                return;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
 
+        profiler.mark(FramePhase::Acquire);
+
         updateUniformBuffer(currentFrame);
 
         vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
         /*
-         * Record command buffer, first reset command buffer.
+         * Record command buffer, first reset command buffer. Static command
+         * buffers were recorded up front and only need to be picked.
          */
-        vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+        if (options.staticCommandBuffers)
+        {
+            if (staticCommandBuffers.empty())
+            {
+                recordStaticCommandBuffers();
+            }
+            commandBuffer = staticCommandBuffers[imageIndex * MAX_FRAMES_IN_FLIGHT + currentFrame];
+        }
+        else
+        {
+            vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+            recordCommandBuffer(commandBuffer, imageIndex, currentFrame);
+        }
+        profiler.mark(FramePhase::Record);
 
         /*
          * Submit command buffer
@@ -2605,23 +3757,33 @@ private:
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+        /*
+         * Headless frames have no image to wait for and nothing to present
+         */
         VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+        submitInfo.pCommandBuffers = &commandBuffer;
 
         VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        profiler.mark(FramePhase::Submit);
+
+        if (options.headless)
+        {
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return;
+        }
 
         /*
          * Presentation - submitting result back to swap chain to show up on screen
@@ -2638,7 +3800,8 @@ private:
 
         presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        profiler.mark(FramePhase::Present);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
         {
@@ -2654,23 +3817,23 @@ private:
     }
 
     /**
-     * Create a Vulkan shader module from the provided code.
+     * Create a Vulkan shader module from an embedded shader.
      *
-     * @param code A vector containing the binary code of the shader.
+     * @param shader The SPIR-V of the shader, see findShader().
      * @return A Vulkan shader module.
      * @throws std::runtime_error if the shader module creation fails.
      */
-    VkShaderModule createShaderModule(const std::vector<char> &code)
+    VkShaderModule createShaderModule(const ShaderBinary &shader)
     {
         /*
          * The sType member is set to indicate the type of structure, VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO.
-         * The codeSize member is assigned the size of the code vector, while the pCode member is assigned a
-         * reinterpretation of the code vector as a pointer to an array of const uint32_t.
+         * The codeSize member is assigned the size of the SPIR-V in bytes, while the pCode member points
+         * straight at the embedded array of uint32_t words.
          */
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        createInfo.codeSize = shader.size;
+        createInfo.pCode = shader.code;
 
         VkShaderModule shaderModule;
 
@@ -2805,8 +3968,9 @@ private:
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported)
+        /* Headless runs render into images of their own */
+        bool swapChainAdequate = options.headless;
+        if (extensionsSupported && !options.headless)
         {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -2832,7 +3996,8 @@ private:
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char *> extensions = requiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto &extension : availableExtensions)
         {
@@ -2842,6 +4007,15 @@ private:
         return requiredExtensions.empty();
     }
 
+    /**
+     * @return The device extensions to enable: the swap chain extension, or none
+     * when headless.
+     */
+    std::vector<const char *> requiredDeviceExtensions()
+    {
+        return options.headless ? std::vector<const char *>() : deviceExtensions;
+    }
+
     /**
      * Checks which queue families are supported by the device and which one of these supports the commands that we
      * want to use.
@@ -2870,8 +4044,19 @@ private:
                 indices.graphicsFamily = i;
             }
 
+            /*
+             * Headless runs present nothing, so the graphics family stands in
+             * for the present family
+             */
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (options.headless)
+            {
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
 
             if (presentSupport)
             {
@@ -2886,6 +4071,25 @@ private:
             i++;
         }
 
+        /*
+         * Uploads prefer a family that can only transfer, which usually maps to
+         * the GPU's copy engines and runs alongside graphics work. uploadImage()
+         * copies arbitrary bands of rows, so the family must not restrict image
+         * transfer granularity.
+         */
+        for (uint32_t j = 0; j < queueFamilyCount; j++)
+        {
+            VkQueueFlags flags = queueFamilies[j].queueFlags;
+            VkExtent3D granularity = queueFamilies[j].minImageTransferGranularity;
+
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+                granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+            {
+                indices.transferFamily = j;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -2896,11 +4100,19 @@ private:
      */
     std::vector<const char *> getRequiredExtensions()
     {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char *> extensions;
+
+        /*
+         * Window system extensions are only needed to create the surface
+         */
+        if (!options.headless)
+        {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         /*
          * VK_EXT_DEBUG_UTILS_EXTENSION_NAME macro here which is equal to the literal string "VK_EXT_debug_utils".
@@ -2954,44 +4166,6 @@ private:
         return true;
     }
 
-    /**
-     * Read the contents of a file and return them as a vector of characters.
-     *
-     * @param filename The name of the file to read.
-     * @return A vector containing the characters read from the file.
-     * @throws std::runtime_error if the file fails to open.
-     */
-    static std::vector<char> readFile(const std::string &filename)
-    {
-        /*
-         * Open the file in binary mode, starting at the end
-         * to determine the file size.
-         */
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open())
-        {
-            throw std::runtime_error("failed to open file!");
-        }
-
-        /*
-         * Determine the file size and allocate a buffer accordingly.
-         */
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        /*
-         * Move the file pointer to the beginning and read
-         * the file contents into the buffer.
-         */
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
-        return buffer;
-    }
-
     /**
      * The VKAPI_ATTR and VKAPI_CALL ensure that the function has the right signature for Vulkan to call it.
      *
@@ -3022,16 +4196,224 @@ private:
     }
 };
 
+/**
+ * Parses the command line.
+ *
+ *      --loader-threads N  Threads used to parse the OBJ model (0 = all cores, 1 = serial tinyobj)
+ *      --verify-loader     Check that the parallel OBJ loader matches the serial loader
+ *      --optimize-mesh     Reorder the model for vertex cache and vertex fetch locality
+ *      --vertex-format F   Vertex layout uploaded to the GPU: float (default) or packed
+ *      --index-type T      Index size: uint16 (default, splits large meshes) or uint32
+ *      --staging-size MB   Capacity of the upload staging ring in MiB (default 16)
+ *      --immediate-uploads Submit and wait for each upload command separately (for comparison)
+ *      --no-transfer-queue Upload on the graphics queue even if the device has a transfer-only queue family
+ *      --headless          Render offscreen, without a window (for CI and render farm nodes)
+ *      --width N           Window or offscreen image width in pixels (default 800)
+ *      --height N          Window or offscreen image height in pixels (default 600)
+ *      --frames N          Exit after N frames (headless default 100, windowed default: when closed)
+ *      --benchmark M       Measure M frames after the warm-up and report CPU frame and drawFrame() phase times
+ *      --warmup N          Frames to run before measuring (default 60)
+ *      --benchmark-json F  Where to write the benchmark report as JSON (default benchmark.json)
+ *      --gpu-timestamps F  Time render pass on the GPU, per frame into CSV file F, summary at exit
+ *      --frame-stats F     Count recorded commands and pipeline statistics, per frame into CSV file F, summary at exit
+ *      --startup-report    Print wall and CPU time per initialization stage
+ *      --startup-json F    Also write the startup report as JSON to file F
+ *      --exit-after-init   Exit after initialization, for timing cold and warm starts
+ *      --pipeline-cache F  Load and save compiled pipelines in file F (default pipeline_cache.bin)
+ *      --no-pipeline-cache Compile all pipelines from scratch and don't save them
+ *      --pipeline-threads N Threads compiling pipelines in the background (default 1, 0 = inside initVulkan())
+ *      --static-command-buffers Record the frame's commands once per framebuffer and reuse them every frame
+ *      --record-threads N  Record the render pass into secondary command buffers on N threads (default 0 = inline)
+ *      --draw-repeat N     Draw the model N times per frame, a synthetic many-draw scene (default 1)
+ *
+ * @return The parsed options.
+ */
+ApplicationOptions parseOptions(int argc, char **argv)
+{
+    ApplicationOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--loader-threads" && i + 1 < argc)
+        {
+            options.loaderThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--verify-loader")
+        {
+            options.verifyLoader = true;
+        }
+        else if (arg == "--optimize-mesh")
+        {
+            options.optimizeMesh = true;
+        }
+        else if (arg == "--vertex-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "float")
+            {
+                options.vertexFormat = VertexFormat::Float;
+            }
+            else if (format == "packed")
+            {
+                options.vertexFormat = VertexFormat::Packed;
+            }
+            else
+            {
+                throw std::runtime_error("unknown vertex format " + format + "!");
+            }
+        }
+        else if (arg == "--index-type" && i + 1 < argc)
+        {
+            std::string type = argv[++i];
+            if (type == "uint16")
+            {
+                options.indexType = VK_INDEX_TYPE_UINT16;
+            }
+            else if (type == "uint32")
+            {
+                options.indexType = VK_INDEX_TYPE_UINT32;
+            }
+            else
+            {
+                throw std::runtime_error("unknown index type " + type + "!");
+            }
+        }
+        else if (arg == "--staging-size" && i + 1 < argc)
+        {
+            options.stagingSize = static_cast<VkDeviceSize>(std::stoul(argv[++i])) * 1024 * 1024;
+            if (options.stagingSize == 0)
+            {
+                throw std::runtime_error("staging ring size must be at least 1 MiB!");
+            }
+        }
+        else if (arg == "--immediate-uploads")
+        {
+            options.immediateUploads = true;
+        }
+        else if (arg == "--no-transfer-queue")
+        {
+            options.transferQueue = false;
+        }
+        else if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--height" && i + 1 < argc)
+        {
+            options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            options.benchmarkFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            options.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark-json" && i + 1 < argc)
+        {
+            options.benchmarkJson = argv[++i];
+        }
+        else if (arg == "--gpu-timestamps" && i + 1 < argc)
+        {
+            options.gpuTimestamps = argv[++i];
+        }
+        else if (arg == "--frame-stats" && i + 1 < argc)
+        {
+            options.frameStatistics = argv[++i];
+        }
+        else if (arg == "--startup-report")
+        {
+            options.startupReport = true;
+        }
+        else if (arg == "--startup-json" && i + 1 < argc)
+        {
+            options.startupReport = true;
+            options.startupJson = argv[++i];
+        }
+        else if (arg == "--exit-after-init")
+        {
+            options.exitAfterInit = true;
+        }
+        else if (arg == "--pipeline-cache" && i + 1 < argc)
+        {
+            options.pipelineCache = argv[++i];
+        }
+        else if (arg == "--no-pipeline-cache")
+        {
+            options.pipelineCache.clear();
+        }
+        else if (arg == "--pipeline-threads" && i + 1 < argc)
+        {
+            options.pipelineThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--static-command-buffers")
+        {
+            options.staticCommandBuffers = true;
+        }
+        else if (arg == "--record-threads" && i + 1 < argc)
+        {
+            options.recordThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--draw-repeat" && i + 1 < argc)
+        {
+            options.drawRepeat = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (options.drawRepeat == 0)
+            {
+                throw std::runtime_error("draw repeat must be at least 1!");
+            }
+        }
+        else
+        {
+            throw std::runtime_error("unknown option " + arg + "!");
+        }
+    }
+
+    if (options.width == 0 || options.height == 0)
+    {
+        throw std::runtime_error("width and height must be at least 1 pixel!");
+    }
+    if (options.benchmarkFrames > 0)
+    {
+        options.frames = options.warmupFrames + options.benchmarkFrames;
+    }
+    if (options.headless && options.frames == 0)
+    {
+        options.frames = HEADLESS_DEFAULT_FRAMES;
+    }
+    if (options.staticCommandBuffers && (!options.gpuTimestamps.empty() || !options.frameStatistics.empty()))
+    {
+        /* Both reset and read back their queries per recorded frame, see GpuTimer::begin() */
+        throw std::runtime_error("--static-command-buffers can't be combined with --gpu-timestamps or --frame-stats!");
+    }
+    if (options.staticCommandBuffers && options.recordThreads > 0)
+    {
+        /* The recording threads reuse their secondary command buffers every frame */
+        throw std::runtime_error("--static-command-buffers can't be combined with --record-threads!");
+    }
+
+    return options;
+}
+
 /**
  * Main code that is compiled and run
  * @return exit code
  */
-int main()
+int main(int argc, char **argv)
 {
-    HelloTriangleApplication app;
-
     try
     {
+        HelloTriangleApplication app(parseOptions(argc, argv));
         app.run();
     }
     catch (const std::exception &e)
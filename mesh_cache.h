@@ -0,0 +1,340 @@
+/**
+ * Versioned binary mesh cache.
+ *
+ * Parsing a text OBJ file and deduplicating its vertices is by far the slowest
+ * part of startup. The first time a model is loaded the welded vertex and index
+ * arrays are written to a small binary file next to the source; later launches
+ * memory-map that file and copy the arrays out directly.
+ *
+ * File layout:
+ *      MeshCacheHeader
+ *      Vertex[vertexCount]     (packed, vertexStride bytes each)
+ *      uint32_t[indexCount]
+ *
+ * The header records the size, modification time and FNV-1a hash of the source
+ * file. A cache hit only needs a stat() of the source; the hash is computed only
+ * when the size matches but the timestamp does not (e.g. after a fresh checkout),
+ * so touching a file does not force a full re-parse.
+ */
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * "VKMC" in little endian. Bump MESH_CACHE_VERSION whenever the layout of the
+ * header or of the cached vertex type changes.
+ */
+const uint32_t MESH_CACHE_MAGIC = 0x434D4B56;
+const uint32_t MESH_CACHE_VERSION = 1;
+
+/**
+ * Header stored at the beginning of every mesh cache file.
+ */
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;        // Producer defined, e.g. which post-processing was applied
+    uint32_t vertexStride; // sizeof(Vertex) of the writer
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+};
+
+/**
+ * Size and modification time of a file on disk.
+ */
+struct MeshCacheSourceInfo
+{
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+/**
+ * Queries size and modification time of a file.
+ *
+ * @param path Path of the file.
+ * @param info Receives the file information.
+ * @return true if the file exists.
+ */
+inline bool meshCacheStat(const std::string &path, MeshCacheSourceInfo &info)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+
+    info.size = static_cast<uint64_t>(st.st_size);
+    info.mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+/**
+ * Computes the 64-bit FNV-1a hash of a file's contents.
+ *
+ * @param path Path of the file.
+ * @return The hash, or 0 if the file cannot be read.
+ */
+inline uint64_t meshCacheHashFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    std::vector<char> chunk(1 << 16);
+    while (file)
+    {
+        file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        std::streamsize count = file.gcount();
+        for (std::streamsize i = 0; i < count; i++)
+        {
+            hash ^= static_cast<unsigned char>(chunk[i]);
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * Read-only view of a whole file, memory-mapped where the platform allows it and
+ * read into a heap buffer otherwise.
+ */
+class MeshCacheFile
+{
+public:
+    explicit MeshCacheFile(const std::string &path)
+    {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                bytes = static_cast<const char *>(mapped);
+                byteCount = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+#else
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            return;
+        }
+
+        fallback.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(fallback.data(), static_cast<std::streamsize>(fallback.size()));
+        bytes = fallback.data();
+        byteCount = fallback.size();
+#endif
+    }
+
+    ~MeshCacheFile()
+    {
+#ifndef _WIN32
+        if (bytes != nullptr)
+        {
+            munmap(const_cast<char *>(bytes), byteCount);
+        }
+#endif
+    }
+
+    MeshCacheFile(const MeshCacheFile &) = delete;
+    MeshCacheFile &operator=(const MeshCacheFile &) = delete;
+
+    const char *data() const { return bytes; }
+    size_t size() const { return byteCount; }
+
+private:
+    const char *bytes = nullptr;
+    size_t byteCount = 0;
+#ifdef _WIN32
+    std::vector<char> fallback;
+#endif
+};
+
+/**
+ * Writes a mesh cache file. The data goes to a temporary file first which is then
+ * renamed over the destination, so a crash never leaves a truncated cache behind.
+ *
+ * @param cachePath Path of the cache file to write.
+ * @param sourcePath Path of the source model the data was generated from.
+ * @param flags Producer defined flags stored in the header.
+ * @param vertices Welded vertex array.
+ * @param indices Index array.
+ * @return true on success. Failing to write a cache is never fatal.
+ */
+template <typename VertexT>
+bool writeMeshCache(const std::string &cachePath, const std::string &sourcePath, uint32_t flags,
+                    const std::vector<VertexT> &vertices, const std::vector<uint32_t> &indices)
+{
+    static_assert(std::is_trivially_copyable<VertexT>::value, "cached vertex type must be trivially copyable");
+
+    MeshCacheSourceInfo source;
+    if (!meshCacheStat(sourcePath, source))
+    {
+        return false;
+    }
+
+    MeshCacheHeader header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.flags = flags;
+    header.vertexStride = sizeof(VertexT);
+    header.vertexCount = vertices.size();
+    header.indexCount = indices.size();
+    header.sourceSize = source.size;
+    header.sourceMtime = source.mtime;
+    header.sourceHash = meshCacheHashFile(sourcePath);
+
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(vertices.data()), static_cast<std::streamsize>(sizeof(VertexT) * vertices.size()));
+        file.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(sizeof(uint32_t) * indices.size()));
+        if (!file)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Tries to load a mesh from its cache file.
+ *
+ * The cache is rejected if its magic, version, flags or vertex stride don't match,
+ * if it is truncated, or if the source file changed since it was written. When the
+ * source only has a new timestamp but identical contents, the header is refreshed
+ * in place so the next launch takes the fast path again.
+ *
+ * @param cachePath Path of the cache file.
+ * @param sourcePath Path of the source model.
+ * @param flags Flags the cache must have been written with.
+ * @param vertices Receives the vertex array on success.
+ * @param indices Receives the index array on success.
+ * @return true on a cache hit, false if the caller has to rebuild the mesh.
+ */
+template <typename VertexT>
+bool loadMeshCache(const std::string &cachePath, const std::string &sourcePath, uint32_t flags,
+                   std::vector<VertexT> &vertices, std::vector<uint32_t> &indices)
+{
+    static_assert(std::is_trivially_copyable<VertexT>::value, "cached vertex type must be trivially copyable");
+
+    MeshCacheSourceInfo source;
+    if (!meshCacheStat(sourcePath, source))
+    {
+        return false;
+    }
+
+    MeshCacheHeader header{};
+    bool touched = false;
+    {
+        MeshCacheFile file(cachePath);
+        if (file.data() == nullptr || file.size() < sizeof(MeshCacheHeader))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+            header.flags != flags || header.vertexStride != sizeof(VertexT))
+        {
+            return false;
+        }
+
+        /* Bound the counts first, so a corrupt header cannot wrap the products */
+        uint64_t payloadBytes = file.size() - sizeof(MeshCacheHeader);
+        if (header.vertexCount > payloadBytes / sizeof(VertexT) || header.indexCount > payloadBytes / sizeof(uint32_t))
+        {
+            return false;
+        }
+
+        uint64_t vertexBytes = header.vertexCount * sizeof(VertexT);
+        uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+        if (file.size() != sizeof(MeshCacheHeader) + vertexBytes + indexBytes)
+        {
+            return false;
+        }
+
+        /*
+         * Size and timestamp match: trust the cache without reading the source.
+         */
+        if (header.sourceSize != source.size)
+        {
+            return false;
+        }
+        if (header.sourceMtime != source.mtime)
+        {
+            if (meshCacheHashFile(sourcePath) != header.sourceHash)
+            {
+                return false;
+            }
+            touched = true;
+        }
+
+        const char *payload = file.data() + sizeof(MeshCacheHeader);
+        vertices.resize(header.vertexCount);
+        indices.resize(header.indexCount);
+        std::memcpy(vertices.data(), payload, vertexBytes);
+        std::memcpy(indices.data(), payload + vertexBytes, indexBytes);
+    }
+
+    if (touched)
+    {
+        header.sourceMtime = source.mtime;
+        std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+        if (file.is_open())
+        {
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        }
+    }
+
+    return true;
+}
+
+#endif // MESH_CACHE_H
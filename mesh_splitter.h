@@ -0,0 +1,135 @@
+/**
+ * Conversion of 32-bit indexed triangle lists to 16-bit index buffers.
+ *
+ * A mesh with at most 65536 vertices is converted directly. Larger meshes are
+ * split, in triangle order, into chunks that each reference at most 65536
+ * vertices. Every chunk's vertices are stored contiguously, so a chunk is drawn
+ * with its 16-bit indices plus the chunk's vertexOffset. Vertices used by several
+ * chunks are duplicated into each of them.
+ */
+#ifndef MESH_SPLITTER_H
+#define MESH_SPLITTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Number of distinct vertices a 16-bit index can address
+ */
+const uint32_t MESH_SPLITTER_MAX_CHUNK_VERTICES = 65536;
+
+/**
+ * Range of a split mesh that is drawn with one indexed draw call.
+ */
+struct MeshChunk
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+};
+
+/**
+ * Splits a triangle list into 16-bit addressable chunks.
+ *
+ * @param vertices Input vertices.
+ * @param indices Input triangle list indices.
+ * @param outVertices Receives the vertices, grouped by chunk.
+ * @param outIndices Receives the chunk-relative 16-bit indices.
+ * @param outChunks Receives one entry per chunk.
+ * @param maxChunkVertices Vertex limit per chunk, at most 65536.
+ */
+template <typename VertexT>
+void splitMesh16(const std::vector<VertexT> &vertices, const std::vector<uint32_t> &indices,
+                 std::vector<VertexT> &outVertices, std::vector<uint16_t> &outIndices, std::vector<MeshChunk> &outChunks,
+                 uint32_t maxChunkVertices = MESH_SPLITTER_MAX_CHUNK_VERTICES)
+{
+    if (maxChunkVertices < 3 || maxChunkVertices > MESH_SPLITTER_MAX_CHUNK_VERTICES)
+    {
+        throw std::runtime_error("invalid mesh chunk vertex limit!");
+    }
+
+    outVertices.clear();
+    outIndices.clear();
+    outChunks.clear();
+    outIndices.reserve(indices.size());
+
+    /*
+     * Fast path: everything fits, no remapping needed.
+     */
+    if (vertices.size() <= maxChunkVertices)
+    {
+        outVertices = vertices;
+        for (uint32_t index : indices)
+        {
+            if (index >= vertices.size())
+            {
+                throw std::runtime_error("mesh index out of range!");
+            }
+            outIndices.push_back(static_cast<uint16_t>(index));
+        }
+        outChunks.push_back({0, static_cast<uint32_t>(indices.size()), 0, static_cast<uint32_t>(vertices.size())});
+        return;
+    }
+
+    /*
+     * chunkOf[v] tells which chunk vertex v was last added to, localIndex[v] where.
+     */
+    const uint32_t NONE = UINT32_MAX;
+    std::vector<uint32_t> chunkOf(vertices.size(), NONE);
+    std::vector<uint16_t> localIndex(vertices.size(), 0);
+    outVertices.reserve(vertices.size() + vertices.size() / 16);
+
+    MeshChunk chunk{0, 0, 0, 0};
+    uint32_t chunkId = 0;
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        uint32_t newVertices = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t + k];
+            if (v >= vertices.size())
+            {
+                throw std::runtime_error("mesh index out of range!");
+            }
+            bool repeated = (k > 0 && indices[t + k - 1] == v) || (k > 1 && indices[t] == v);
+            if (chunkOf[v] != chunkId && !repeated)
+            {
+                newVertices++;
+            }
+        }
+
+        if (chunk.vertexCount + newVertices > maxChunkVertices)
+        {
+            outChunks.push_back(chunk);
+            chunkId++;
+            chunk.firstIndex = static_cast<uint32_t>(outIndices.size());
+            chunk.indexCount = 0;
+            chunk.vertexOffset = static_cast<int32_t>(outVertices.size());
+            chunk.vertexCount = 0;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t + k];
+            if (chunkOf[v] != chunkId)
+            {
+                chunkOf[v] = chunkId;
+                localIndex[v] = static_cast<uint16_t>(chunk.vertexCount++);
+                outVertices.push_back(vertices[v]);
+            }
+            outIndices.push_back(localIndex[v]);
+        }
+        chunk.indexCount += 3;
+    }
+
+    if (chunk.indexCount > 0)
+    {
+        outChunks.push_back(chunk);
+    }
+}
+
+#endif // MESH_SPLITTER_H
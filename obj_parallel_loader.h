@@ -0,0 +1,479 @@
+/**
+ * Multi-threaded OBJ ingestion.
+ *
+ * The file is read into memory and split into line-aligned byte ranges. Each
+ * range is parsed on a worker thread (positions, texture coordinates and face
+ * corners), the per-range attribute arrays are concatenated, and every range then
+ * triangulates and welds its own corners into a local vertex table. The local
+ * tables are finally merged in file order, which yields exactly the vertices and
+ * indices a serial tinyobj::LoadObj + VertexWelder pass produces, independent of
+ * the thread count.
+ *
+ * Numbers are parsed with tinyobj's own parser and quads are split with the same
+ * shortest-diagonal rule, so this header must be included after tiny_obj_loader.h
+ * in the translation unit that defines TINYOBJLOADER_IMPLEMENTATION. Faces with
+ * more than four corners are not handled (tinyobj ear-clips them); the loader
+ * reports that and the caller falls back to tinyobj.
+ */
+#ifndef OBJ_PARALLEL_LOADER_H
+#define OBJ_PARALLEL_LOADER_H
+
+#ifndef TINYOBJLOADER_IMPLEMENTATION
+#error "obj_parallel_loader.h must be included after the tinyobj implementation"
+#endif
+
+#include "vertex_welder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs task(0) ... task(taskCount - 1) on 'threadCount' threads. Tasks are handed
+ * out dynamically so uneven ranges still balance. The first exception thrown by a
+ * task is rethrown on the calling thread.
+ */
+inline void objParallelFor(size_t taskCount, unsigned threadCount, const std::function<void(size_t)> &task)
+{
+    std::atomic<size_t> nextTask{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]()
+    {
+        for (size_t i = nextTask++; i < taskCount; i = nextTask++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount && i < taskCount; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * Parallel OBJ loader producing welded vertex and 32-bit index arrays.
+ */
+template <typename VertexT>
+class ObjParallelLoader
+{
+public:
+    /**
+     * @param threadCount Number of worker threads, 0 for one per hardware thread.
+     */
+    explicit ObjParallelLoader(unsigned threadCount)
+        : threadCount(threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    /**
+     * Loads an OBJ file.
+     *
+     * @param path Path of the OBJ file.
+     * @param makeVertex Callable building a vertex from a position (3 reals) and a
+     *        texture coordinate (2 reals), as the serial loader would.
+     * @param vertices Receives the unique vertices.
+     * @param indices Receives one index per triangle corner.
+     * @return false if the file contains polygons this loader can't triangulate
+     *         identically to tinyobj; the outputs are left empty in that case.
+     */
+    template <typename MakeVertex>
+    bool load(const std::string &path, MakeVertex makeVertex, std::vector<VertexT> &vertices, std::vector<uint32_t> &indices)
+    {
+        readFile(path);
+        splitChunks();
+
+        /*
+         * Pass 1: parse every range into local attribute and corner arrays.
+         */
+        objParallelFor(chunks.size(), threadCount, [this](size_t i)
+                       { parseChunk(chunks[i]); });
+
+        size_t positionCount = 0;
+        size_t texcoordCount = 0;
+        for (auto &chunk : chunks)
+        {
+            if (chunk.hasLargePolygon)
+            {
+                return false;
+            }
+            chunk.positionOffset = positionCount;
+            chunk.texcoordOffset = texcoordCount;
+            positionCount += chunk.positions.size() / 3;
+            texcoordCount += chunk.texcoords.size() / 2;
+        }
+
+        positions.resize(positionCount * 3);
+        texcoords.resize(texcoordCount * 2);
+        objParallelFor(chunks.size(), threadCount, [this](size_t i)
+                       {
+                           Chunk &chunk = chunks[i];
+                           std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset * 3);
+                           std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordOffset * 2);
+                       });
+
+        /*
+         * Pass 2: resolve indices, triangulate and weld each range on its own.
+         */
+        objParallelFor(chunks.size(), threadCount, [this, &makeVertex](size_t i)
+                       { weldChunk(chunks[i], makeVertex); });
+
+        /*
+         * Merge the local tables in file order. A vertex first seen in range k is
+         * first seen globally there too, and local tables preserve first-use order,
+         * so this reproduces the serial output order exactly.
+         */
+        size_t localVertexCount = 0;
+        size_t indexCount = 0;
+        for (auto &chunk : chunks)
+        {
+            chunk.indexOffset = indexCount;
+            localVertexCount += chunk.vertices.size();
+            indexCount += chunk.indices.size();
+        }
+
+        vertices.clear();
+        vertices.reserve(std::min(localVertexCount, positionCount * 2));
+        VertexWelder<VertexT> welder(positionCount);
+        for (auto &chunk : chunks)
+        {
+            chunk.remap.resize(chunk.vertices.size());
+            for (size_t v = 0; v < chunk.vertices.size(); v++)
+            {
+                chunk.remap[v] = welder.weld(chunk.vertices[v], vertices);
+            }
+        }
+
+        indices.resize(indexCount);
+        objParallelFor(chunks.size(), threadCount, [this, &indices](size_t i)
+                       {
+                           Chunk &chunk = chunks[i];
+                           uint32_t *out = indices.data() + chunk.indexOffset;
+                           for (uint32_t index : chunk.indices)
+                           {
+                               *out++ = chunk.remap[index];
+                           }
+                       });
+
+        return true;
+    }
+
+private:
+    /*
+     * Face corner as parsed. Positive OBJ indices are absolute; negative ones are
+     * relative to the attribute count at that line, which is only known within the
+     * range until the range offsets have been computed.
+     */
+    struct Corner
+    {
+        int32_t position;
+        int32_t texcoord;
+        bool positionRelative;
+        bool texcoordRelative;
+    };
+
+    struct Chunk
+    {
+        char *begin;
+        char *end;
+
+        std::vector<tinyobj::real_t> positions;
+        std::vector<tinyobj::real_t> texcoords;
+        std::vector<Corner> corners;
+        std::vector<uint32_t> faceSizes;
+        bool hasLargePolygon = false;
+
+        size_t positionOffset = 0;
+        size_t texcoordOffset = 0;
+        size_t indexOffset = 0;
+
+        std::vector<VertexT> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> remap;
+    };
+
+    /*
+     * Reads the whole file and appends a terminating zero so the tinyobj number
+     * parser never runs past the end.
+     */
+    void readFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open file " + path + "!");
+        }
+
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        buffer.resize(fileSize + 1);
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(fileSize));
+        buffer[fileSize] = '\0';
+    }
+
+    /*
+     * Splits the buffer into ranges that start and end on line boundaries. More
+     * ranges than threads are created so that dynamic scheduling can even out
+     * ranges dominated by faces vs. attributes.
+     */
+    void splitChunks()
+    {
+        size_t fileSize = buffer.size() - 1;
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount * 4, fileSize / (64 * 1024)));
+        size_t chunkSize = fileSize / chunkCount + 1;
+
+        chunks.clear();
+        char *cursor = buffer.data();
+        char *fileEnd = buffer.data() + fileSize;
+        while (cursor < fileEnd)
+        {
+            char *end = cursor + std::min<size_t>(chunkSize, static_cast<size_t>(fileEnd - cursor));
+            end = static_cast<char *>(std::memchr(end - 1, '\n', static_cast<size_t>(fileEnd - (end - 1))));
+            end = end != nullptr ? end + 1 : fileEnd;
+
+            Chunk chunk;
+            chunk.begin = cursor;
+            chunk.end = end;
+            chunks.push_back(std::move(chunk));
+            cursor = end;
+        }
+    }
+
+    /*
+     * Converts an OBJ index to a Corner field, mirroring tinyobj's fixIndex().
+     */
+    static void parseIndex(const char *token, size_t localCount, int32_t &index, bool &relative)
+    {
+        int value = std::atoi(token);
+        if (value > 0)
+        {
+            index = value - 1;
+            relative = false;
+        }
+        else if (value < 0)
+        {
+            index = static_cast<int32_t>(localCount) + value;
+            relative = true;
+        }
+        else
+        {
+            throw std::runtime_error("failed to load model: zero index in face!");
+        }
+    }
+
+    /*
+     * Parses the 'v', 'vt' and 'f' lines of one range. Every other statement
+     * (normals, groups, materials, ...) does not affect the output and is skipped.
+     */
+    void parseChunk(Chunk &chunk)
+    {
+        char *line = chunk.begin;
+        while (line < chunk.end)
+        {
+            char *lineEnd = static_cast<char *>(std::memchr(line, '\n', static_cast<size_t>(chunk.end - line)));
+            if (lineEnd == nullptr)
+            {
+                lineEnd = chunk.end;
+            }
+            *lineEnd = '\0';
+
+            const char *token = line + std::strspn(line, " \t");
+            line = lineEnd + 1;
+
+            if (token[0] == 'v' && (token[1] == ' ' || token[1] == '\t'))
+            {
+                token += 2;
+                tinyobj::real_t x, y, z;
+                tinyobj::parseReal3(&x, &y, &z, &token);
+                chunk.positions.push_back(x);
+                chunk.positions.push_back(y);
+                chunk.positions.push_back(z);
+            }
+            else if (token[0] == 'v' && token[1] == 't' && (token[2] == ' ' || token[2] == '\t'))
+            {
+                token += 3;
+                tinyobj::real_t u, v;
+                tinyobj::parseReal2(&u, &v, &token);
+                chunk.texcoords.push_back(u);
+                chunk.texcoords.push_back(v);
+            }
+            else if (token[0] == 'f' && (token[1] == ' ' || token[1] == '\t'))
+            {
+                token += 2;
+                token += std::strspn(token, " \t");
+
+                uint32_t faceSize = 0;
+                while (token[0] != '\0' && token[0] != '\r' && token[0] != '\n')
+                {
+                    Corner corner{0, -1, false, false};
+                    parseIndex(token, chunk.positions.size() / 3, corner.position, corner.positionRelative);
+                    token += std::strcspn(token, "/ \t\r");
+
+                    if (token[0] == '/')
+                    {
+                        token++;
+                        if (token[0] != '/')
+                        {
+                            parseIndex(token, chunk.texcoords.size() / 2, corner.texcoord, corner.texcoordRelative);
+                            token += std::strcspn(token, "/ \t\r");
+                        }
+                        if (token[0] == '/')
+                        {
+                            token++;
+                            token += std::strcspn(token, "/ \t\r");
+                        }
+                    }
+
+                    chunk.corners.push_back(corner);
+                    faceSize++;
+                    token += std::strspn(token, " \t\r");
+                }
+
+                if (faceSize > 4)
+                {
+                    chunk.hasLargePolygon = true;
+                }
+                chunk.faceSizes.push_back(faceSize);
+            }
+        }
+    }
+
+    /*
+     * Turns a parsed corner into global position/texcoord indices.
+     */
+    void resolve(const Chunk &chunk, const Corner &corner, size_t &position, size_t &texcoord) const
+    {
+        int64_t p = corner.position + (corner.positionRelative ? static_cast<int64_t>(chunk.positionOffset) : 0);
+        int64_t t = corner.texcoord + (corner.texcoordRelative ? static_cast<int64_t>(chunk.texcoordOffset) : 0);
+
+        if (p < 0 || static_cast<size_t>(p) >= positions.size() / 3)
+        {
+            throw std::runtime_error("failed to load model: vertex index out of range!");
+        }
+        if (t < 0 || static_cast<size_t>(t) >= texcoords.size() / 2)
+        {
+            throw std::runtime_error("failed to load model: missing or invalid texture coordinate index!");
+        }
+
+        position = static_cast<size_t>(p);
+        texcoord = static_cast<size_t>(t);
+    }
+
+    template <typename MakeVertex>
+    void weldChunk(Chunk &chunk, MakeVertex &makeVertex)
+    {
+        VertexWelder<VertexT> welder(chunk.corners.size() / 4);
+        chunk.indices.reserve(chunk.corners.size() * 3 / 2);
+
+        auto emit = [&](size_t position, size_t texcoord)
+        {
+            VertexT vertex = makeVertex(&positions[3 * position], &texcoords[2 * texcoord]);
+            chunk.indices.push_back(welder.weld(vertex, chunk.vertices));
+        };
+
+        size_t first = 0;
+        for (uint32_t faceSize : chunk.faceSizes)
+        {
+            size_t p[4];
+            size_t t[4];
+            if (faceSize >= 3)
+            {
+                for (uint32_t k = 0; k < faceSize; k++)
+                {
+                    resolve(chunk, chunk.corners[first + k], p[k], t[k]);
+                }
+            }
+
+            if (faceSize == 3)
+            {
+                emit(p[0], t[0]);
+                emit(p[1], t[1]);
+                emit(p[2], t[2]);
+            }
+            else if (faceSize == 4)
+            {
+                /*
+                 * Same split as tinyobj: cut along the shorter diagonal.
+                 */
+                const tinyobj::real_t *v0 = &positions[3 * p[0]];
+                const tinyobj::real_t *v1 = &positions[3 * p[1]];
+                const tinyobj::real_t *v2 = &positions[3 * p[2]];
+                const tinyobj::real_t *v3 = &positions[3 * p[3]];
+
+                tinyobj::real_t e02x = v2[0] - v0[0];
+                tinyobj::real_t e02y = v2[1] - v0[1];
+                tinyobj::real_t e02z = v2[2] - v0[2];
+                tinyobj::real_t e13x = v3[0] - v1[0];
+                tinyobj::real_t e13y = v3[1] - v1[1];
+                tinyobj::real_t e13z = v3[2] - v1[2];
+
+                tinyobj::real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+                tinyobj::real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+                if (sqr02 < sqr13)
+                {
+                    emit(p[0], t[0]);
+                    emit(p[1], t[1]);
+                    emit(p[2], t[2]);
+                    emit(p[0], t[0]);
+                    emit(p[2], t[2]);
+                    emit(p[3], t[3]);
+                }
+                else
+                {
+                    emit(p[0], t[0]);
+                    emit(p[1], t[1]);
+                    emit(p[3], t[3]);
+                    emit(p[1], t[1]);
+                    emit(p[2], t[2]);
+                    emit(p[3], t[3]);
+                }
+            }
+
+            first += faceSize;
+        }
+    }
+
+    unsigned threadCount;
+    std::vector<char> buffer;
+    std::vector<Chunk> chunks;
+    std::vector<tinyobj::real_t> positions;
+    std::vector<tinyobj::real_t> texcoords;
+};
+
+#endif // OBJ_PARALLEL_LOADER_H
@@ -0,0 +1,210 @@
+/**
+ * VkPipelineCache persisted to disk between launches.
+ *
+ * Without a pipeline cache, every launch compiles all shaders in the driver
+ * again. PersistentPipelineCache seeds a VkPipelineCache with the data stored
+ * by the previous run. save() writes the data back, through a temporary file
+ * that is renamed over the destination like writeMeshCache() does, so a crash
+ * never leaves a truncated cache behind.
+ *
+ * The driver rejects or ignores data that it does not recognize. The file
+ * header is checked up front anyway (header version, vendor ID, device ID and
+ * pipelineCacheUUID), so the report can tell a warm start from a cold one and
+ * stale data from another GPU or driver is never passed in. The header fields
+ * are stored least significant byte first, whatever the host byte order.
+ */
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Size of the VK_PIPELINE_CACHE_HEADER_VERSION_ONE header
+ */
+const size_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+class PersistentPipelineCache
+{
+public:
+    /**
+     * @param device Logical device that creates the pipelines.
+     * @param physicalDevice Device whose IDs and cache UUID the file must match.
+     * @param path Cache file, empty for an in-memory cache that is never loaded or saved.
+     */
+    PersistentPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &path)
+        : device(device), path(path)
+    {
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        std::vector<char> data;
+        if (path.empty())
+        {
+            cacheStatus = "disabled";
+        }
+        else if (!readFile(data))
+        {
+            cacheStatus = "cold (no cache file)";
+        }
+        else if (!validHeader(data))
+        {
+            cacheStatus = "cold (cache file from another device or driver)";
+            data.clear();
+        }
+        else
+        {
+            cacheStatus = "warm";
+            warmStart = true;
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    ~PersistentPipelineCache()
+    {
+        vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    PersistentPipelineCache(const PersistentPipelineCache &) = delete;
+    PersistentPipelineCache &operator=(const PersistentPipelineCache &) = delete;
+
+    /**
+     * @return The cache to pass to every vkCreate*Pipelines() call.
+     */
+    VkPipelineCache handle() const
+    {
+        return cache;
+    }
+
+    /**
+     * @return True if the cache was seeded from a valid file.
+     */
+    bool warm() const
+    {
+        return warmStart;
+    }
+
+    /**
+     * @return How the cache was initialized, for reports.
+     */
+    const std::string &status() const
+    {
+        return cacheStatus;
+    }
+
+    /**
+     * Writes the cache contents to the file.
+     *
+     * @return true on success, or if the cache is in-memory only. Failing to
+     *         write a cache is never fatal.
+     */
+    bool save() const
+    {
+        if (path.empty())
+        {
+            return true;
+        }
+
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS)
+        {
+            return false;
+        }
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+        {
+            return false;
+        }
+        data.resize(size);
+
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file)
+            {
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    bool readFile(std::vector<char> &data) const
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+
+    static uint32_t readLittleEndian32(const std::vector<char> &data, size_t offset)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data()) + offset;
+        return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+               static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    /*
+     * Checks the VkPipelineCacheHeaderVersionOne at the start of 'data' against this device.
+     */
+    bool validHeader(const std::vector<char> &data) const
+    {
+        if (data.size() < PIPELINE_CACHE_HEADER_SIZE)
+        {
+            return false;
+        }
+
+        uint32_t headerSize = readLittleEndian32(data, 0);
+        uint32_t headerVersion = readLittleEndian32(data, 4);
+        uint32_t vendorID = readLittleEndian32(data, 8);
+        uint32_t deviceID = readLittleEndian32(data, 12);
+
+        return headerSize >= PIPELINE_CACHE_HEADER_SIZE && headerSize <= data.size() &&
+               headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               vendorID == properties.vendorID && deviceID == properties.deviceID &&
+               std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkDevice device;
+    std::string path;
+    VkPhysicalDeviceProperties properties{};
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    bool warmStart = false;
+    std::string cacheStatus;
+};
+
+#endif // PIPELINE_CACHE_H
@@ -0,0 +1,207 @@
+/**
+ * Background pipeline compilation.
+ *
+ * Creating a pipeline makes the driver compile its shaders, which can take
+ * longer than any other startup step when a scene has many pipelines. A
+ * PipelineCompiler runs the creation functions on worker threads instead:
+ *
+ *      graphicsPipeline = compiler.submit([this]() { return compileGraphicsPipeline(); });
+ *      ... load textures and models, upload buffers ...
+ *      vkCmdBindPipeline(commandBuffer, ..., graphicsPipeline.get());
+ *
+ * submit() returns an AsyncPipeline at once. Its get() blocks only if the
+ * pipeline is still compiling, so the first frame waits just for the pipelines
+ * it binds. The creation function must only read state that stays unchanged
+ * while it runs. vkCreate*Pipelines() may be called from several threads at a
+ * time, and a VkPipelineCache is internally synchronized.
+ *
+ * With zero threads, submit() compiles on the calling thread, as the code did
+ * before.
+ */
+#ifndef PIPELINE_COMPILER_H
+#define PIPELINE_COMPILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * A pipeline that may still be compiling.
+ */
+class AsyncPipeline
+{
+public:
+    AsyncPipeline() = default;
+
+    /**
+     * @return True once the pipeline has been created, or its creation failed.
+     */
+    bool ready() const
+    {
+        return state && state->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /**
+     * Waits for the pipeline and returns it. Rethrows the exception if its
+     * creation failed.
+     */
+    VkPipeline get() const
+    {
+        if (!state)
+        {
+            return VK_NULL_HANDLE;
+        }
+
+        if (!state->waited)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            state->result.wait();
+            state->waitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            state->waited = true;
+        }
+        return state->result.get();
+    }
+
+    /**
+     * @return Time the creation function took, valid once ready().
+     */
+    double compileMilliseconds() const
+    {
+        return state ? state->compileMilliseconds : 0.0;
+    }
+
+    /**
+     * @return Time the first get() blocked the caller.
+     */
+    double waitMilliseconds() const
+    {
+        return state ? state->waitMilliseconds : 0.0;
+    }
+
+private:
+    friend class PipelineCompiler;
+
+    struct State
+    {
+        std::shared_future<VkPipeline> result;
+        double compileMilliseconds = 0.0; // Written by the worker before the result is set
+        double waitMilliseconds = 0.0;    // Only touched by the thread calling get()
+        bool waited = false;
+    };
+
+    explicit AsyncPipeline(std::shared_ptr<State> state)
+        : state(std::move(state))
+    {
+    }
+
+    std::shared_ptr<State> state;
+};
+
+class PipelineCompiler
+{
+public:
+    /**
+     * @param threadCount Worker threads, 0 to compile on the thread calling submit().
+     */
+    explicit PipelineCompiler(unsigned threadCount)
+    {
+        for (unsigned i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([this]()
+                                 { workerLoop(); });
+        }
+    }
+
+    /**
+     * Finishes all submitted pipelines and joins the workers.
+     */
+    ~PipelineCompiler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    PipelineCompiler(const PipelineCompiler &) = delete;
+    PipelineCompiler &operator=(const PipelineCompiler &) = delete;
+
+    /**
+     * Queues 'create', which creates a pipeline and returns it or throws.
+     */
+    AsyncPipeline submit(std::function<VkPipeline()> create)
+    {
+        std::shared_ptr<AsyncPipeline::State> state = std::make_shared<AsyncPipeline::State>();
+        std::packaged_task<VkPipeline()> task([state, create]()
+                                              {
+            auto start = std::chrono::high_resolution_clock::now();
+            VkPipeline pipeline = create();
+            state->compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            return pipeline; });
+        state->result = task.get_future().share();
+
+        if (threads.empty())
+        {
+            task();
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(std::move(task));
+            }
+            wake.notify_one();
+        }
+        return AsyncPipeline(state);
+    }
+
+    unsigned threadCount() const
+    {
+        return static_cast<unsigned>(threads.size());
+    }
+
+private:
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::packaged_task<VkPipeline()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]()
+                          { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                {
+                    return;
+                }
+                task = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            /* Exceptions end up in the task's future */
+            task();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::packaged_task<VkPipeline()>> jobs;
+    bool stopping = false;
+};
+
+#endif // PIPELINE_COMPILER_H
@@ -0,0 +1,54 @@
+/**
+ * SPIR-V shaders embedded in the executable.
+ *
+ * The build compiles the GLSL sources in shaders/ with glslc and turns the
+ * SPIR-V into constexpr uint32_t arrays in the generated embedded_shaders.h
+ * (see shaders/embed_spirv.cmake). Loading a shader is then a table lookup:
+ * there is no file I/O, no copy, and no dependence on the working directory.
+ * uint32_t arrays already meet the 4-byte alignment that
+ * VkShaderModuleCreateInfo::pCode requires.
+ *
+ *      VkShaderModule module = createShaderModule(findShader("vert"));
+ *
+ * Shaders are named after their SPIR-V file without the extension: vert,
+ * frag, vertQuantized, vertCompute, fragCompute, comp and particleInit.
+ */
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/**
+ * An embedded SPIR-V module.
+ */
+struct ShaderBinary
+{
+    const char *name;
+    const uint32_t *code;
+    size_t size; // In bytes, as VkShaderModuleCreateInfo::codeSize expects
+};
+
+#include "embedded_shaders.h"
+
+/**
+ * Looks up an embedded shader by name.
+ *
+ * @throws std::runtime_error if the build did not embed a shader of that name.
+ */
+inline const ShaderBinary &findShader(const std::string &name)
+{
+    for (const ShaderBinary &shader : EMBEDDED_SHADERS)
+    {
+        if (std::strcmp(shader.name, name.c_str()) == 0)
+        {
+            return shader;
+        }
+    }
+    throw std::runtime_error("shader " + name + " is not embedded!");
+}
+
+#endif // SHADER_LIBRARY_H
@@ -1,2 +0,0 @@
-/usr/local/VulkanSDK/macOS/bin/glslc shader.vert -o vert.spv
-/usr/local/VulkanSDK/macOS/bin/glslc shader.frag -o frag.spv
\ No newline at end of file
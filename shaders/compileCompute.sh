@@ -1,3 +0,0 @@
-/usr/local/VulkanSDK/macOS/bin/glslc shaderCompute.vert -o vertCompute.spv
-/usr/local/VulkanSDK/macOS/bin/glslc shaderCompute.frag -o fragCompute.spv
-/usr/local/VulkanSDK/macOS/bin/glslc comp.comp -o comp.spv
\ No newline at end of file
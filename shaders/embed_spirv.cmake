@@ -0,0 +1,61 @@
+# Writes the SPIR-V files in SHADERS into a C++ header, as one constexpr
+# uint32_t array per shader plus the EMBEDDED_SHADERS table that
+# shader_library.h searches. Run by the build, see CMakeLists.txt:
+#
+#   cmake -DOUTPUT=embedded_shaders.h -DSHADERS=a.spv|b.spv -P embed_spirv.cmake
+#
+# Shaders are named after their file without the extension. SPIR-V is a
+# stream of little-endian 32-bit words, so every 4 bytes are swapped into
+# one word literal.
+
+if(NOT OUTPUT OR NOT SHADERS)
+    message(FATAL_ERROR "embed_spirv.cmake needs OUTPUT and SHADERS")
+endif()
+
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(ARRAYS "")
+set(TABLE "")
+foreach(SPV ${SHADERS})
+    get_filename_component(NAME ${SPV} NAME_WE)
+    string(MAKE_C_IDENTIFIER "SPIRV_${NAME}" SYMBOL)
+    string(TOUPPER ${SYMBOL} SYMBOL)
+
+    file(READ ${SPV} HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+    if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SPV} is not a SPIR-V module")
+    endif()
+
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+    # Eight words per line (CMake regular expressions have no {n} repetition)
+    string(REPEAT "0x[0-9a-f]+, " 7 LINE_PATTERN)
+    string(REGEX REPLACE "(${LINE_PATTERN}0x[0-9a-f]+,) " "\\1\n    " WORDS "${WORDS}")
+    string(REGEX REPLACE ",\n    $" "" WORDS "${WORDS}")
+    string(REGEX REPLACE ", $" "" WORDS "${WORDS}")
+
+    string(APPEND ARRAYS "inline constexpr uint32_t ${SYMBOL}[] = {\n    ${WORDS}};\n\n")
+    string(APPEND TABLE "    {\"${NAME}\", ${SYMBOL}, sizeof(${SYMBOL})},\n")
+endforeach()
+
+set(CONTENT "/*
+ * Generated by shaders/embed_spirv.cmake, do not edit. Included by shader_library.h.
+ */
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+${ARRAYS}inline constexpr ShaderBinary EMBEDDED_SHADERS[] = {
+${TABLE}};
+
+#endif // EMBEDDED_SHADERS_H
+")
+
+# Leave the header untouched if nothing changed, so dependents don't rebuild
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} OLD_CONTENT)
+    if(OLD_CONTENT STREQUAL CONTENT)
+        return()
+    endif()
+endif()
+file(WRITE ${OUTPUT} "${CONTENT}")
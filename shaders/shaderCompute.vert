@@ -2,12 +2,18 @@
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inPreviousPosition; // One simulation step before inPosition
+
+// Fraction of a step the frame lies past inPreviousPosition
+layout(push_constant) uniform Interpolation {
+    float alpha;
+} interpolation;
 
 layout(location = 0) out vec3 fragColor;
 
 void main() {
 
     gl_PointSize = 14.0;
-    gl_Position = vec4(inPosition.xy, 1.0, 1.0);
+    gl_Position = vec4(mix(inPreviousPosition, inPosition, interpolation.alpha), 1.0, 1.0);
     fragColor = inColor.rgb;
 }
\ No newline at end of file
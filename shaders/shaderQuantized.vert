@@ -0,0 +1,27 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform VertexQuantization {
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 texCoordOffsetScale;
+    vec4 color;
+} quantization;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main() {
+    vec3 position = quantization.positionOffset.xyz + inPosition.xyz * quantization.positionScale.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+    fragColor = quantization.color.rgb;
+    fragTexCoord = quantization.texCoordOffsetScale.xy + inTexCoord * quantization.texCoordOffsetScale.zw;
+}
\ No newline at end of file
@@ -0,0 +1,356 @@
+/**
+ * Persistently mapped staging ring for host to device uploads.
+ *
+ * Instead of creating, mapping and destroying a staging buffer per upload, all
+ * uploads write into one host-visible buffer that stays mapped for the lifetime
+ * of the application. Space is handed out front to back and wraps around at
+ * the end of the buffer:
+ *
+ *      allocate()  Reserves a region and returns its buffer offset and host pointer.
+ *      nextFence() Returns the fence that the caller passes to the vkQueueSubmit()
+ *                  reading the regions allocated since the previous commit.
+ *      commit()    Closes that batch once the submission has succeeded.
+ *      reclaim()   Retires committed regions whose fence has signaled.
+ *
+ * When the ring is full, allocate() waits for the oldest committed region to be
+ * consumed by the GPU (back-pressure). Regions that are allocated but not yet
+ * committed cannot be waited for, so a single batch of uncommitted uploads must
+ * fit in the ring; tryAllocate() reports when the batch has to be submitted first.
+ *
+ * Every commit gets a serial number, so the ring doubles as the completion
+ * tracker for the submissions it fences (see isComplete() and wait()).
+ */
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Default staging ring capacity
+ */
+const VkDeviceSize STAGING_RING_DEFAULT_SIZE = 16ull * 1024 * 1024;
+
+/**
+ * A region of the staging ring.
+ */
+struct StagingRegion
+{
+    VkBuffer buffer;     // Staging buffer to use as transfer source
+    VkDeviceSize offset; // Offset of the region in 'buffer'
+    void *data;          // Host pointer to the region
+};
+
+/**
+ * Upload counters of a staging ring.
+ */
+struct StagingRingStats
+{
+    uint64_t allocations = 0;
+    uint64_t bytesAllocated = 0;
+    uint64_t submissions = 0;       // commit() calls
+    uint64_t backPressureWaits = 0; // times allocate() had to wait for the GPU
+};
+
+class StagingRing
+{
+public:
+    /**
+     * @param device Logical device used for the fences.
+     * @param buffer Host-visible, host-coherent buffer created with
+     *        VK_BUFFER_USAGE_TRANSFER_SRC_BIT. It is owned by the caller and must
+     *        outlive the ring.
+     * @param mapped Persistent host mapping of 'buffer'.
+     * @param capacity Size of 'buffer' in bytes.
+     */
+    StagingRing(VkDevice device, VkBuffer buffer, void *mapped, VkDeviceSize capacity)
+        : device(device), buffer(buffer), mapped(static_cast<char *>(mapped)), ringCapacity(capacity)
+    {
+    }
+
+    /**
+     * Waits for all committed regions and destroys the fences.
+     */
+    ~StagingRing()
+    {
+        waitIdle();
+        for (VkFence fence : freeFences)
+        {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        if (reservedFence != VK_NULL_HANDLE)
+        {
+            vkDestroyFence(device, reservedFence, nullptr);
+        }
+    }
+
+    StagingRing(const StagingRing &) = delete;
+    StagingRing &operator=(const StagingRing &) = delete;
+
+    /**
+     * Reserves 'size' bytes, waiting for the GPU to consume older regions if the
+     * ring is full.
+     *
+     * @param size Region size, at most capacity().
+     * @param alignment Required alignment of the region offset.
+     * @return The reserved region.
+     */
+    StagingRegion allocate(VkDeviceSize size, VkDeviceSize alignment = 16)
+    {
+        StagingRegion region{};
+        if (!tryAllocate(size, alignment, region))
+        {
+            throw std::runtime_error("staging ring too small for the uncommitted uploads!");
+        }
+        return region;
+    }
+
+    /**
+     * Like allocate(), but returns false instead of throwing when the region can
+     * only be placed after the uncommitted regions have been committed.
+     */
+    bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, StagingRegion &region)
+    {
+        if (size > ringCapacity)
+        {
+            throw std::runtime_error("staging upload larger than the staging ring!");
+        }
+
+        reclaim();
+
+        VkDeviceSize offset;
+        while (!tryReserve(size, alignment, offset))
+        {
+            if (inFlight.empty())
+            {
+                return false;
+            }
+            waitOldest();
+            stats.backPressureWaits++;
+        }
+
+        stats.allocations++;
+        stats.bytesAllocated += size;
+        region = StagingRegion{buffer, offset, mapped + offset};
+        return true;
+    }
+
+    /**
+     * Fence for the submission that reads the current batch of regions. The same
+     * fence is returned until commit() is called, so a failed vkQueueSubmit()
+     * leaves nothing behind that could never signal.
+     */
+    VkFence nextFence()
+    {
+        if (reservedFence == VK_NULL_HANDLE)
+        {
+            reservedFence = acquireFence();
+        }
+        return reservedFence;
+    }
+
+    /**
+     * Closes the current batch of regions, which may be empty. Call it only after
+     * the submission signaling nextFence() has been accepted by the queue.
+     *
+     * @param includePending False for submissions that do not read the regions
+     *        allocated since the previous commit, for example ones on another queue.
+     *        The regions then stay pending for the next commit.
+     * @return The fence of the batch. Its serial is lastSerial().
+     */
+    VkFence commit(bool includePending = true)
+    {
+        VkFence fence = nextFence();
+        reservedFence = VK_NULL_HANDLE;
+        inFlight.push_back(Batch{fence, ++submittedSerial, includePending ? pendingBytes : 0});
+        if (includePending)
+        {
+            pendingBytes = 0;
+        }
+        stats.submissions++;
+        return fence;
+    }
+
+    /**
+     * Serial of the most recent commit(), 0 before the first one.
+     */
+    uint64_t lastSerial() const
+    {
+        return submittedSerial;
+    }
+
+    /**
+     * Tells whether the submission fenced by commit number 'serial' has finished.
+     */
+    bool isComplete(uint64_t serial)
+    {
+        reclaim();
+        return serial <= completedSerial;
+    }
+
+    /**
+     * Blocks until the submission fenced by commit number 'serial' has finished.
+     */
+    void wait(uint64_t serial)
+    {
+        while (completedSerial < serial && !inFlight.empty())
+        {
+            waitOldest();
+        }
+    }
+
+    /**
+     * Retires committed batches whose fence has signaled, without blocking.
+     */
+    void reclaim()
+    {
+        while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS)
+        {
+            retireOldest();
+        }
+    }
+
+    /**
+     * Blocks until all committed batches have been consumed.
+     */
+    void waitIdle()
+    {
+        while (!inFlight.empty())
+        {
+            waitOldest();
+        }
+    }
+
+    VkDeviceSize capacity() const
+    {
+        return ringCapacity;
+    }
+
+    const StagingRingStats &statistics() const
+    {
+        return stats;
+    }
+
+private:
+    struct Batch
+    {
+        VkFence fence;
+        uint64_t serial;
+        VkDeviceSize bytes; // Ring bytes covered by the batch, including alignment and wrap-around padding
+    };
+
+    /*
+     * Places 'size' bytes after 'head', wrapping to the start of the ring if they
+     * do not fit before the end. Live data occupies [tail, head) modulo capacity.
+     */
+    bool tryReserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+    {
+        if (usedBytes == 0)
+        {
+            head = 0;
+            tail = 0;
+        }
+
+        VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+        VkDeviceSize consumed;
+
+        if (usedBytes == 0 || head > tail)
+        {
+            if (aligned + size <= ringCapacity)
+            {
+                offset = aligned;
+                consumed = aligned + size - head;
+            }
+            else if (size <= tail)
+            {
+                offset = 0;
+                consumed = ringCapacity - head + size;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (aligned + size <= tail)
+        {
+            offset = aligned;
+            consumed = aligned + size - head;
+        }
+        else
+        {
+            return false;
+        }
+
+        head = (offset + size) % ringCapacity;
+        usedBytes += consumed;
+        pendingBytes += consumed;
+        return true;
+    }
+
+    void waitOldest()
+    {
+        VkFence fence = inFlight.front().fence;
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        retireOldest();
+    }
+
+    void retireOldest()
+    {
+        Batch batch = inFlight.front();
+        inFlight.pop_front();
+
+        /*
+         * Batches are laid out back to back, so the oldest live byte moves past
+         * everything the retired batch covered
+         */
+        tail = (tail + batch.bytes) % ringCapacity;
+        usedBytes -= batch.bytes;
+        completedSerial = batch.serial;
+
+        vkResetFences(device, 1, &batch.fence);
+        freeFences.push_back(batch.fence);
+    }
+
+    VkFence acquireFence()
+    {
+        if (!freeFences.empty())
+        {
+            VkFence fence = freeFences.back();
+            freeFences.pop_back();
+            return fence;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkFence fence;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create staging ring fence!");
+        }
+        return fence;
+    }
+
+    VkDevice device;
+    VkBuffer buffer;
+    char *mapped;
+    VkDeviceSize ringCapacity;
+
+    VkDeviceSize head = 0;         // Next free position
+    VkDeviceSize tail = 0;         // Start of the oldest live region
+    VkDeviceSize usedBytes = 0;    // Live bytes between tail and head, including padding
+    VkDeviceSize pendingBytes = 0; // Part of usedBytes not yet committed
+    uint64_t submittedSerial = 0;
+    uint64_t completedSerial = 0;
+
+    std::deque<Batch> inFlight;
+    std::vector<VkFence> freeFences;
+    VkFence reservedFence = VK_NULL_HANDLE; // Handed out by nextFence(), not yet committed
+    StagingRingStats stats;
+};
+
+#endif // STAGING_RING_H
@@ -0,0 +1,164 @@
+/**
+ * Startup time breakdown.
+ *
+ * Like FrameProfiler, setup code calls mark() after each stage. A mark charges
+ * the wall-clock and process CPU time since the previous mark (or since
+ * construction) to the named stage:
+ *
+ *      StartupProfiler startup;
+ *      createInstance();               startup.mark("createInstance")
+ *      pickPhysicalDevice();           startup.mark("pickPhysicalDevice")
+ *      ...
+ *
+ * CPU time covers all threads of the process. It exceeds the wall time for
+ * stages that use worker threads, and falls well short of it for stages that
+ * wait for the driver, the GPU or the disk.
+ *
+ * report() prints a table, and writeJson() writes the same numbers for
+ * scripts comparing cold and warm starts.
+ */
+#ifndef STARTUP_PROFILER_H
+#define STARTUP_PROFILER_H
+
+#include "frame_profiler.h"
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Time spent in one startup stage, in milliseconds.
+ */
+struct StartupStage
+{
+    std::string name;
+    double wallMilliseconds;
+    double cpuMilliseconds;
+};
+
+class StartupProfiler
+{
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    StartupProfiler()
+        : start(Clock::now()), lastMark(start), cpuStart(std::clock()), lastCpuMark(cpuStart)
+    {
+    }
+
+    /**
+     * Charges the time since the previous mark to 'stage'.
+     */
+    void mark(const std::string &stage)
+    {
+        Clock::time_point now = Clock::now();
+        std::clock_t cpuNow = std::clock();
+
+        stages.push_back(StartupStage{stage, std::chrono::duration<double, std::milli>(now - lastMark).count(),
+                                      cpuMilliseconds(cpuNow - lastCpuMark)});
+        lastMark = now;
+        lastCpuMark = cpuNow;
+    }
+
+    /**
+     * Adds a key/value pair describing the run (device, pipeline cache, ...) to the report.
+     */
+    void setInfo(const std::string &key, const std::string &value)
+    {
+        info.push_back(std::make_pair(key, value));
+    }
+
+    /**
+     * @return Wall-clock milliseconds from construction to the last mark.
+     */
+    double totalMilliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(lastMark - start).count();
+    }
+
+    /**
+     * @return Process CPU milliseconds from construction to the last mark.
+     */
+    double totalCpuMilliseconds() const
+    {
+        return cpuMilliseconds(lastCpuMark - cpuStart);
+    }
+
+    /**
+     * Prints wall and CPU time per stage, in call order.
+     */
+    void report(std::ostream &out) const
+    {
+        double total = totalMilliseconds();
+
+        out << "Startup: " << std::fixed << std::setprecision(3) << total << " ms wall, " << totalCpuMilliseconds()
+            << " ms CPU" << std::defaultfloat << std::endl;
+        for (const auto &entry : info)
+        {
+            out << "    " << entry.first << ": " << entry.second << std::endl;
+        }
+
+        out << "    " << std::left << std::setw(34) << "stage" << std::right << std::setw(12) << "wall ms"
+            << std::setw(12) << "cpu ms" << std::setw(8) << "%" << std::endl;
+        for (const StartupStage &stage : stages)
+        {
+            out << "    " << std::left << std::setw(34) << stage.name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(12) << stage.wallMilliseconds << std::setw(12) << stage.cpuMilliseconds
+                << std::setprecision(1) << std::setw(8) << (total > 0.0 ? 100.0 * stage.wallMilliseconds / total : 0.0)
+                << std::defaultfloat << std::endl;
+        }
+    }
+
+    /**
+     * Writes the report as JSON:
+     *
+     *      {"info": {...}, "wall_ms": W, "cpu_ms": C,
+     *       "stages": [{"name": "createInstance", "wall_ms": ..., "cpu_ms": ...}, ...]}
+     */
+    void writeJson(const std::string &path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("failed to open startup report " + path + "!");
+        }
+
+        file << std::setprecision(6) << "{\n  \"info\": {";
+        for (size_t i = 0; i < info.size(); i++)
+        {
+            file << (i ? ", " : "") << jsonString(info[i].first) << ": " << jsonString(info[i].second);
+        }
+        file << "},\n";
+        file << "  \"wall_ms\": " << totalMilliseconds() << ",\n";
+        file << "  \"cpu_ms\": " << totalCpuMilliseconds() << ",\n";
+        file << "  \"stages\": [\n";
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            file << "    {\"name\": " << jsonString(stages[i].name) << ", \"wall_ms\": " << stages[i].wallMilliseconds
+                 << ", \"cpu_ms\": " << stages[i].cpuMilliseconds << "}" << (i + 1 < stages.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+    }
+
+private:
+    static double cpuMilliseconds(std::clock_t ticks)
+    {
+        return 1000.0 * static_cast<double>(ticks) / CLOCKS_PER_SEC;
+    }
+
+    Clock::time_point start;
+    Clock::time_point lastMark;
+    std::clock_t cpuStart;
+    std::clock_t lastCpuMark;
+
+    std::vector<StartupStage> stages;
+    std::vector<std::pair<std::string, std::string>> info;
+};
+
+#endif // STARTUP_PROFILER_H
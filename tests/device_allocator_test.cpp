@@ -0,0 +1,338 @@
+/**
+ * Drives DeviceAllocator with MockMemoryBackend, no GPU needed.
+ *
+ * Usage: DeviceAllocatorTest
+ *
+ * Covered:
+ *      Alignment of every placement, and no two placements overlapping.
+ *      TLSF splitting (alignment padding and tails become free ranges, slivers
+ *      count as waste) and coalescing of neighbours on free.
+ *      Dedicated allocations above half a block, and when a block can't be had.
+ *      Separate linear and optimal pools when bufferImageGranularity > 1.
+ *      Block reuse and release, host mapping and the stats() counters.
+ */
+#include "../device_allocator.h"
+
+#include "test_harness.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+const VkDeviceSize BLOCK_SIZE = 1024 * 1024;
+
+/*
+ * Memory types of the test device
+ */
+const uint32_t DEVICE_LOCAL_TYPE = 0;
+const uint32_t HOST_VISIBLE_TYPE = 1;
+
+VkPhysicalDeviceMemoryProperties makeMemoryProperties()
+{
+    VkPhysicalDeviceMemoryProperties properties{};
+    properties.memoryTypeCount = 2;
+    properties.memoryTypes[DEVICE_LOCAL_TYPE].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[HOST_VISIBLE_TYPE].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    properties.memoryHeapCount = 1;
+    properties.memoryHeaps[0].size = 256 * BLOCK_SIZE;
+    return properties;
+}
+
+VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkMemoryRequirements result{};
+    result.size = size;
+    result.alignment = alignment;
+    result.memoryTypeBits = ~0u;
+    return result;
+}
+
+/**
+ * Every placement is aligned and none overlaps another in the same memory.
+ */
+void testAlignment()
+{
+    std::cout << "alignment" << std::endl;
+    MockMemoryBackend backend;
+    DeviceAllocator allocator(backend, makeMemoryProperties(), 1, BLOCK_SIZE);
+
+    const VkDeviceSize alignments[] = {1, 4, 16, 64, 256, 4096, 65536};
+    std::vector<DeviceAllocation> allocations;
+    Random random;
+    for (int i = 0; i < 300; i++)
+    {
+        VkDeviceSize size = 1 + random.below(20000);
+        VkDeviceSize alignment = alignments[random.below(7)];
+
+        DeviceAllocation allocation = allocator.allocate(requirements(size, alignment), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+        check(allocation.offset % alignment == 0, "offset " + std::to_string(allocation.offset) + " aligned to " + std::to_string(alignment));
+        check(allocation.offset + allocation.size <= BLOCK_SIZE, "placement inside its block");
+        allocations.push_back(allocation);
+
+        /* Free every third one so later placements land in recycled ranges */
+        if (i % 3 == 2)
+        {
+            allocator.free(allocations[allocations.size() - 2]);
+        }
+    }
+
+    std::vector<std::tuple<VkDeviceMemory, VkDeviceSize, VkDeviceSize>> ranges;
+    for (const auto &allocation : allocations)
+    {
+        if (allocation.memory != VK_NULL_HANDLE)
+        {
+            ranges.emplace_back(allocation.memory, allocation.offset, allocation.offset + allocation.size);
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); i++)
+    {
+        if (std::get<0>(ranges[i]) == std::get<0>(ranges[i - 1]))
+        {
+            check(std::get<1>(ranges[i]) >= std::get<2>(ranges[i - 1]), "placements do not overlap");
+        }
+    }
+
+    for (auto &allocation : allocations)
+    {
+        allocator.free(allocation);
+    }
+    check(allocator.stats().allocationCount == 0, "everything freed");
+}
+
+/**
+ * Ranges are split off on allocation and merged with free neighbours on free.
+ */
+void testSplitAndCoalesce()
+{
+    std::cout << "split and coalesce" << std::endl;
+    MockMemoryBackend backend;
+    DeviceAllocator allocator(backend, makeMemoryProperties(), 1, BLOCK_SIZE);
+
+    DeviceAllocation a = allocator.allocate(requirements(1000, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    DeviceAllocation b = allocator.allocate(requirements(1000, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    DeviceAllocation c = allocator.allocate(requirements(1000, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(a.memory == b.memory && b.memory == c.memory, "small allocations share one block");
+    check(a.offset == 0 && b.offset == 1024 && c.offset == 2048, "consecutive placements");
+
+    /* The 24 bytes in front of b and c are below the smallest tracked range and count as waste */
+    DeviceAllocatorStats stats = allocator.stats();
+    check(stats.blockCount == 1 && stats.allocationCount == 3, "one block, three allocations");
+    check(stats.bytesUsed == 3000, "bytes used");
+    check(stats.bytesWasted == 48, "b and c each keep 24 bytes of padding");
+    check(stats.bytesFree == BLOCK_SIZE - 3048, "tail split off as a free range");
+    check(stats.largestFreeRange == BLOCK_SIZE - 3048, "largest free range is the tail");
+
+    /* Freeing b leaves a hole that is not adjacent to the tail */
+    allocator.free(b);
+    stats = allocator.stats();
+    check(stats.bytesFree == BLOCK_SIZE - 3048 + 1024, "b returned");
+    check(stats.fragmentation > 0.0, "hole counts as fragmentation");
+
+    /*
+     * Freeing a merges it with b's 2048 byte range. A request rounded up to the
+     * next list that still holds that range must then land at offset 0, not in the tail.
+     */
+    allocator.free(a);
+    DeviceAllocation ab = allocator.allocate(requirements(1900, 1), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(ab.offset == 0, "a and b coalesced into one range");
+    allocator.free(ab);
+
+    /* Freeing c merges everything back into one range spanning the block */
+    allocator.free(c);
+    stats = allocator.stats();
+    check(stats.blockCount == 1, "last empty block is kept");
+    check(stats.bytesFree == BLOCK_SIZE && stats.largestFreeRange == BLOCK_SIZE, "block fully coalesced");
+    check(stats.fragmentation == 0.0, "no fragmentation left");
+    check(stats.bytesWasted == 0 && stats.bytesUsed == 0, "no waste left");
+
+    /* Alignment padding large enough to track becomes a free range of its own */
+    DeviceAllocation small = allocator.allocate(requirements(100, 1), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    DeviceAllocation aligned = allocator.allocate(requirements(100, 4096), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(aligned.offset == 4096, "placed at the next 4096 boundary");
+    check(allocator.stats().bytesWasted == 0, "padding in front was split off");
+    DeviceAllocation padding = allocator.allocate(requirements(1000, 1), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(padding.offset == 100, "padding range is reused");
+
+    allocator.free(small);
+    allocator.free(aligned);
+    allocator.free(padding);
+    check(allocator.stats().largestFreeRange == BLOCK_SIZE, "block fully coalesced again");
+    check(backend.totalAllocateCalls == 1, "one block served everything");
+}
+
+/**
+ * Large resources get their own memory; small ones fall back to it when a block
+ * can't be allocated.
+ */
+void testDedicated()
+{
+    std::cout << "dedicated allocations" << std::endl;
+    MockMemoryBackend backend;
+    DeviceAllocator allocator(backend, makeMemoryProperties(), 1, BLOCK_SIZE);
+
+    DeviceAllocation half = allocator.allocate(requirements(BLOCK_SIZE / 2, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(half.block != nullptr, "half a block still goes into a block");
+
+    DeviceAllocation large = allocator.allocate(requirements(BLOCK_SIZE / 2 + 1, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(large.block == nullptr && large.offset == 0, "more than half a block is dedicated");
+    check(large.memory != half.memory, "dedicated allocation has its own memory");
+    check(backend.allocationCount == 2 && backend.bytesAllocated == BLOCK_SIZE + BLOCK_SIZE / 2 + 1, "backend sees a block and the dedicated allocation");
+
+    DeviceAllocatorStats stats = allocator.stats();
+    check(stats.dedicatedAllocationCount == 1 && stats.allocationCount == 2, "dedicated allocation counted");
+    check(stats.bytesReserved == BLOCK_SIZE + BLOCK_SIZE / 2 + 1, "dedicated bytes reserved");
+    check(stats.bytesUsed == BLOCK_SIZE / 2 + BLOCK_SIZE / 2 + 1, "dedicated bytes used");
+
+    DeviceAllocation mapped = allocator.allocate(requirements(3 * BLOCK_SIZE / 4, 256), HOST_VISIBLE_TYPE, DeviceResourceKind::Linear);
+    check(mapped.block == nullptr && mapped.mapped != nullptr, "host-visible dedicated allocation is mapped");
+
+    allocator.free(large);
+    allocator.free(mapped);
+    check(allocator.stats().dedicatedAllocationCount == 0, "dedicated allocations freed");
+    check(backend.allocationCount == 1, "dedicated memory returned to the backend");
+    allocator.free(half);
+
+    /* A budget below one block makes the pool fall back to exactly sized memory */
+    MockMemoryBackend smallBackend(BLOCK_SIZE / 2);
+    DeviceAllocator smallAllocator(smallBackend, makeMemoryProperties(), 1, BLOCK_SIZE);
+    DeviceAllocation fallback = smallAllocator.allocate(requirements(4096, 256), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+    check(fallback.block == nullptr && smallBackend.bytesAllocated == 4096, "falls back to a dedicated allocation");
+    smallAllocator.free(fallback);
+    check(smallBackend.allocationCount == 0, "fallback freed");
+}
+
+/**
+ * Linear and optimal resources only share blocks when the granularity allows it.
+ */
+void testGranularity()
+{
+    std::cout << "bufferImageGranularity" << std::endl;
+    {
+        MockMemoryBackend backend;
+        DeviceAllocator allocator(backend, makeMemoryProperties(), 4096, BLOCK_SIZE);
+
+        DeviceAllocation buffer = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+        DeviceAllocation image = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Optimal);
+        DeviceAllocation buffer2 = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+        DeviceAllocation image2 = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Optimal);
+        check(buffer.memory != image.memory, "linear and optimal in separate blocks");
+        check(buffer.memory == buffer2.memory && image.memory == image2.memory, "each kind shares its own block");
+        check(allocator.stats().blockCount == 2, "two pools, one block each");
+
+        DeviceAllocation hostBuffer = allocator.allocate(requirements(1000, 16), HOST_VISIBLE_TYPE, DeviceResourceKind::Linear);
+        check(hostBuffer.memory != buffer.memory, "memory types have separate pools");
+        check(allocator.stats().blockCount == 3, "three blocks");
+
+        allocator.free(buffer);
+        allocator.free(image);
+        allocator.free(buffer2);
+        allocator.free(image2);
+        allocator.free(hostBuffer);
+    }
+    {
+        MockMemoryBackend backend;
+        DeviceAllocator allocator(backend, makeMemoryProperties(), 1, BLOCK_SIZE);
+
+        DeviceAllocation buffer = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Linear);
+        DeviceAllocation image = allocator.allocate(requirements(1000, 16), DEVICE_LOCAL_TYPE, DeviceResourceKind::Optimal);
+        check(buffer.memory == image.memory, "granularity 1 shares blocks");
+        allocator.free(buffer);
+        allocator.free(image);
+    }
+}
+
+/**
+ * Blocks are created on demand, one empty block is kept, host memory is mapped.
+ */
+void testBlocksAndStats()
+{
+    std::cout << "blocks and stats" << std::endl;
+    MockMemoryBackend backend;
+    DeviceAllocator allocator(backend, makeMemoryProperties(), 1, BLOCK_SIZE);
+
+    std::vector<DeviceAllocation> allocations;
+    VkDeviceSize used = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        VkDeviceSize size = BLOCK_SIZE / 4 - 1000 + i;
+        allocations.push_back(allocator.allocate(requirements(size, 256), HOST_VISIBLE_TYPE, DeviceResourceKind::Linear));
+        used += size;
+    }
+
+    DeviceAllocatorStats stats = allocator.stats();
+    check(stats.blockCount == 3, "ten quarter-block allocations need three blocks");
+    check(backend.allocationCount == 3, "backend sees three blocks");
+    check(stats.allocationCount == 10, "allocation count");
+    check(stats.bytesUsed == used, "bytes used");
+    check(stats.bytesReserved == 3 * BLOCK_SIZE, "bytes reserved");
+    check(stats.bytesUsed + stats.bytesWasted + stats.bytesFree == stats.bytesReserved, "used + wasted + free == reserved");
+    check(stats.dedicatedAllocationCount == 0, "no dedicated allocations");
+
+    bool mapped = true;
+    for (size_t i = 0; i < allocations.size(); i++)
+    {
+        mapped = mapped && allocations[i].mapped != nullptr;
+        if (allocations[i].mapped != nullptr)
+        {
+            std::memset(allocations[i].mapped, static_cast<int>(i), static_cast<size_t>(allocations[i].size));
+        }
+    }
+    check(mapped, "host-visible allocations are mapped");
+    for (size_t i = 0; i < allocations.size(); i++)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(allocations[i].mapped);
+        check(bytes[0] == i && bytes[allocations[i].size - 1] == i, "mapped ranges are disjoint");
+    }
+
+    for (auto &allocation : allocations)
+    {
+        allocator.free(allocation);
+        check(allocation.memory == VK_NULL_HANDLE, "free() resets the allocation");
+    }
+    stats = allocator.stats();
+    check(stats.blockCount == 1 && backend.allocationCount == 1, "one empty block kept, the rest released");
+    check(stats.allocationCount == 0 && stats.bytesUsed == 0 && stats.bytesFree == BLOCK_SIZE, "empty after freeing");
+
+    DeviceAllocation again = allocator.allocate(requirements(1000, 256), HOST_VISIBLE_TYPE, DeviceResourceKind::Linear);
+    check(backend.totalAllocateCalls == 3, "kept block is reused");
+    allocator.free(again);
+
+    DeviceAllocation none{};
+    allocator.free(none);
+    check(allocator.stats().allocationCount == 0, "freeing an empty allocation is a no-op");
+
+    bool threw = false;
+    try
+    {
+        allocator.allocate(requirements(1000, 256), 2, DeviceResourceKind::Linear);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    check(threw, "invalid memory type index throws");
+}
+
+int main()
+{
+    try
+    {
+        testAlignment();
+        testSplitAndCoalesce();
+        testDedicated();
+        testGranularity();
+        testBlocksAndStats();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return testResult();
+}
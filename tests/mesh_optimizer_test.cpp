@@ -0,0 +1,222 @@
+/**
+ * Unit test of the CPU mesh optimizer.
+ *
+ * Usage: MeshOptimizerTest
+ *
+ * A grid mesh with its triangles shuffled (and each triangle's corners rotated)
+ * is optimized at several cache sizes. The test checks that:
+ *      optimizeVertexCache() does not make the ACMR of analyzeVertexCache() worse,
+ *      and keeps the same triangles with the same winding.
+ *      optimizeVertexFetch() orders vertices by first use, drops unreferenced ones
+ *      and remaps the indices so every corner still refers to the same vertex.
+ */
+#include "../mesh_optimizer.h"
+
+#include "test_harness.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Vertices per side of the test grid
+ */
+const uint32_t GRID_SIDE = 101;
+
+/**
+ * Vertex carrying its original index, so a remap can be traced back.
+ */
+struct TestVertex
+{
+    uint32_t id;
+    float position[3];
+};
+
+/**
+ * Triangle list of a GRID_SIDE x GRID_SIDE vertex grid, two triangles per cell,
+ * in random triangle order with randomly rotated corners.
+ */
+std::vector<uint32_t> makeShuffledGrid(Random &random)
+{
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (uint32_t y = 0; y + 1 < GRID_SIDE; y++)
+    {
+        for (uint32_t x = 0; x + 1 < GRID_SIDE; x++)
+        {
+            uint32_t v0 = y * GRID_SIDE + x;
+            uint32_t v1 = v0 + 1;
+            uint32_t v2 = v0 + GRID_SIDE;
+            uint32_t v3 = v2 + 1;
+            triangles.push_back({v0, v2, v1});
+            triangles.push_back({v1, v2, v3});
+        }
+    }
+
+    for (size_t i = triangles.size() - 1; i > 0; i--)
+    {
+        std::swap(triangles[i], triangles[random.below(static_cast<uint32_t>(i + 1))]);
+    }
+
+    std::vector<uint32_t> indices;
+    for (const auto &triangle : triangles)
+    {
+        uint32_t rotation = random.below(3);
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            indices.push_back(triangle[(k + rotation) % 3]);
+        }
+    }
+    return indices;
+}
+
+/**
+ * Triangles rotated to start at their smallest index, which keeps the winding,
+ * and sorted, so two lists of the same triangles compare equal.
+ */
+std::vector<std::array<uint32_t, 3>> triangleMultiset(const std::vector<uint32_t> &indices)
+{
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        size_t first = i;
+        for (size_t k = i + 1; k < i + 3; k++)
+        {
+            if (indices[k] < indices[first])
+            {
+                first = k;
+            }
+        }
+        size_t offset = first - i;
+        triangles.push_back({indices[i + offset], indices[i + (offset + 1) % 3], indices[i + (offset + 2) % 3]});
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+void testVertexCache(uint32_t cacheSize)
+{
+    std::cout << "optimizeVertexCache, " << cacheSize << " cache entries" << std::endl;
+    Random random;
+    std::vector<uint32_t> indices = makeShuffledGrid(random);
+    const size_t vertexCount = GRID_SIDE * GRID_SIDE;
+
+    std::vector<uint32_t> original = indices;
+    VertexCacheStatistics before = analyzeVertexCache(indices, vertexCount, cacheSize);
+    optimizeVertexCache(indices, vertexCount, cacheSize);
+    VertexCacheStatistics after = analyzeVertexCache(indices, vertexCount, cacheSize);
+
+    std::cout << "    ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    check(after.acmr <= before.acmr, "ACMR does not get worse");
+    check(after.acmr < before.acmr / 2, "ACMR of the shuffled grid at least halves");
+    check(indices.size() == original.size(), "index count unchanged");
+    check(triangleMultiset(indices) == triangleMultiset(original), "same triangles with the same winding");
+
+    /* Already optimized input must not get worse either */
+    optimizeVertexCache(indices, vertexCount, cacheSize);
+    check(analyzeVertexCache(indices, vertexCount, cacheSize).acmr <= after.acmr, "optimizing twice does not get worse");
+}
+
+void testVertexFetch()
+{
+    std::cout << "optimizeVertexFetch" << std::endl;
+    Random random;
+    std::vector<uint32_t> indices = makeShuffledGrid(random);
+
+    /* Vertices in shuffled order, plus some that no triangle references */
+    const uint32_t unusedCount = 37;
+    std::vector<TestVertex> vertices;
+    for (uint32_t i = 0; i < GRID_SIDE * GRID_SIDE + unusedCount; i++)
+    {
+        vertices.push_back(TestVertex{i, {static_cast<float>(i % GRID_SIDE), static_cast<float>(i / GRID_SIDE), 0.0f}});
+    }
+    for (size_t i = vertices.size() - 1; i > 0; i--)
+    {
+        size_t j = random.below(static_cast<uint32_t>(i + 1));
+        std::swap(vertices[i], vertices[j]);
+    }
+    std::vector<uint32_t> position(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        position[vertices[i].id] = i;
+    }
+    for (uint32_t &index : indices)
+    {
+        index = position[index];
+    }
+
+    optimizeVertexCache(indices, vertices.size());
+    std::vector<uint32_t> originalIndices = indices;
+    std::vector<TestVertex> originalVertices = vertices;
+    VertexCacheStatistics before = analyzeVertexCache(indices, vertices.size());
+
+    size_t vertexCount = optimizeVertexFetch(vertices, indices);
+
+    check(vertexCount == vertices.size(), "returns the new vertex count");
+    check(vertexCount == GRID_SIDE * GRID_SIDE, "unreferenced vertices dropped");
+    check(indices.size() == originalIndices.size(), "index count unchanged");
+
+    uint32_t nextNew = 0;
+    bool firstUseOrder = true;
+    bool consistent = true;
+    for (size_t k = 0; k < indices.size(); k++)
+    {
+        if (indices[k] > nextNew)
+        {
+            firstUseOrder = false;
+        }
+        else if (indices[k] == nextNew)
+        {
+            nextNew++;
+        }
+        if (indices[k] >= vertices.size() || vertices[indices[k]].id != originalVertices[originalIndices[k]].id)
+        {
+            consistent = false;
+        }
+    }
+    check(firstUseOrder, "vertices appear in order of first use");
+    check(nextNew == vertexCount, "every remaining vertex is referenced");
+    check(consistent, "every corner refers to the same vertex as before");
+
+    VertexCacheStatistics after = analyzeVertexCache(indices, vertices.size());
+    check(after.vertexTransforms == before.vertexTransforms, "cache behaviour unaffected by the remap");
+
+    std::vector<TestVertex> noVertices;
+    std::vector<uint32_t> noIndices;
+    check(optimizeVertexFetch(noVertices, noIndices) == 0, "empty mesh");
+
+    std::vector<uint32_t> outOfRange = {0, 1, 2};
+    std::vector<TestVertex> twoVertices(2);
+    bool threw = false;
+    try
+    {
+        optimizeVertexFetch(twoVertices, outOfRange);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    check(threw, "out of range index throws");
+}
+
+int main()
+{
+    try
+    {
+        testVertexCache(MESH_OPTIMIZER_CACHE_SIZE);
+        testVertexCache(8);
+        testVertexCache(32);
+        testVertexFetch();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return testResult();
+}
@@ -0,0 +1,304 @@
+/**
+ * Checks that ObjParallelLoader produces bit-identical output to the serial
+ * tinyobj::LoadObj + VertexWelder path of loadModel(), at several thread counts.
+ *
+ * Usage: ObjParallelLoaderTest [scratch directory]
+ *
+ * The synthetic OBJ files are large enough to be split into many ranges, and
+ * cover:
+ *      Triangles and quads, the latter cut along either diagonal.
+ *      Absolute and negative (relative) indices, mixed within one face.
+ *      Faces referencing attributes defined several ranges earlier.
+ *      Texture seams (one position with several texture coordinates).
+ *      v, v/vt and v/vt/vn corners, normals, groups, comments and CRLF lines.
+ *      Polygons with more than four corners, which the loader must refuse so
+ *      that loadModel() falls back to tinyobj.
+ */
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../tiny_obj_loader.h"
+
+#include "../obj_parallel_loader.h"
+#include "../vertex_welder.h"
+
+#include "test_harness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Thread counts every file is loaded with; 0 is one per hardware thread
+ */
+const unsigned THREAD_COUNTS[] = {1, 2, 3, 8, 0};
+
+/*
+ * Grid size of the large synthetic file, a few MB of text
+ */
+const int GRID_COLUMNS = 64;
+const int GRID_ROWS = 320;
+
+/**
+ * Same members as the Vertex struct in main.cpp, without the glm dependency.
+ */
+struct Vertex
+{
+    float pos[3];
+    float color[3];
+    float texCoord[2];
+};
+
+/**
+ * Builds a vertex exactly like makeModelVertex() in main.cpp.
+ */
+Vertex makeVertex(const tinyobj::real_t *position, const tinyobj::real_t *texCoord)
+{
+    Vertex vertex{};
+    vertex.pos[0] = position[0];
+    vertex.pos[1] = position[1];
+    vertex.pos[2] = position[2];
+    vertex.texCoord[0] = texCoord[0];
+    vertex.texCoord[1] = 1.0f - texCoord[1];
+    vertex.color[0] = 1.0f;
+    vertex.color[1] = 1.0f;
+    vertex.color[2] = 1.0f;
+    return vertex;
+}
+
+/**
+ * Writes a grid of quads row by row, every row's attributes followed by the faces
+ * joining it to the previous row.
+ *
+ * @param ngon Append a hexagon to the last row.
+ * @param crlf Use "\r\n" line endings.
+ */
+std::string makeGridObj(bool ngon, bool crlf)
+{
+    Random random;
+    std::ostringstream obj;
+    obj.precision(9);
+    const char *eol = crlf ? "\r\n" : "\n";
+
+    /* 1-based absolute index of grid vertex (row, column); positions and texcoords match */
+    auto absolute = [](int row, int column)
+    {
+        return row * GRID_COLUMNS + column + 1;
+    };
+
+    obj << "# synthetic grid " << GRID_COLUMNS << "x" << GRID_ROWS << eol;
+    obj << "o grid" << eol;
+    for (int row = 0; row < GRID_ROWS; row++)
+    {
+        if (row % 37 == 0)
+        {
+            obj << "g band" << row / 37 << eol;
+            obj << "s " << (row % 2) << eol;
+        }
+
+        for (int column = 0; column < GRID_COLUMNS; column++)
+        {
+            /* Uneven heights, so quads are cut along both diagonals */
+            float height = static_cast<float>(random.below(2001)) / 1000.0f - 1.0f;
+            obj << "v " << column * 0.125f << " " << height << " " << row * -0.0625f << eol;
+        }
+        for (int column = 0; column < GRID_COLUMNS; column++)
+        {
+            obj << "vt " << column / float(GRID_COLUMNS - 1) << " " << row / float(GRID_ROWS - 1) << eol;
+        }
+        obj << "vn 0 1 " << (row % 3) << eol;
+
+        if (row == 0)
+        {
+            continue;
+        }
+
+        /* Attribute counts at this point, negative indices count back from these */
+        int count = (row + 1) * GRID_COLUMNS;
+        int normals = row + 1;
+
+        for (int column = 0; column + 1 < GRID_COLUMNS; column++)
+        {
+            int a = absolute(row - 1, column);
+            int b = absolute(row - 1, column + 1);
+            int c = absolute(row, column + 1);
+            int d = absolute(row, column);
+            auto relative = [count](int index)
+            {
+                return index - count - 1;
+            };
+
+            switch (random.below(6))
+            {
+            case 0:
+                obj << "f " << a << "/" << a << " " << b << "/" << b << " " << c << "/" << c << " " << d << "/" << d << eol;
+                break;
+            case 1:
+                obj << "f " << relative(a) << "/" << relative(a) << " " << relative(b) << "/" << relative(b) << " "
+                    << relative(c) << "/" << relative(c) << " " << relative(d) << "/" << relative(d) << eol;
+                break;
+            case 2:
+                obj << "f " << a << "/" << a << "/" << normals << " " << b << "/" << b << "/" << -1 << " "
+                    << c << "/" << c << "/" << normals << eol;
+                obj << "f\t" << relative(a) << "/" << a << "/1\t" << c << "/" << relative(c) << "/1 "
+                    << d << "/" << d << "/" << -normals << eol;
+                break;
+            case 3:
+            {
+                /* Texture seam: the same positions with the texture coordinates of row 0 */
+                int seam = absolute(0, column);
+                obj << "f " << a << "/" << seam << " " << relative(b) << "/" << seam + 1 << " "
+                    << c << "/" << relative(seam + 1) << " " << d << "/" << relative(seam) << eol;
+                break;
+            }
+            case 4:
+            {
+                /* Reaches back to the first row, many ranges earlier */
+                int far = absolute(0, column);
+                obj << "f " << relative(far) << "/" << relative(far) << " " << a << "/" << relative(a) << " "
+                    << relative(b) << "/" << b << eol;
+                obj << "f " << relative(a) << "/" << a << " " << b << "/" << relative(b) << " "
+                    << c << "/" << c << "  " << relative(d) << "/" << relative(d) << " " << eol;
+                break;
+            }
+            default:
+                obj << "f " << a << "/" << a << " " << b << "/" << b << " " << d << "/" << d << eol;
+                obj << "f " << b << "/" << b << " " << c << "/" << c << " " << d << "/" << d << eol;
+                break;
+            }
+        }
+    }
+
+    if (ngon)
+    {
+        int row = GRID_ROWS - 1;
+        obj << "f";
+        for (int column = 0; column < 6; column++)
+        {
+            int index = absolute(row, column);
+            obj << " " << index << "/" << index;
+        }
+        obj << eol;
+    }
+
+    return obj.str();
+}
+
+/**
+ * Small file holding a triangle, a quad and a pentagon.
+ */
+std::string makePentagonObj()
+{
+    return "v 0 0 0\nv 1 0 0\nv 1.5 1 0\nv 0.5 1.5 0\nv -0.5 1 0\n"
+           "vt 0 0\nvt 1 0\nvt 1 1\nvt 0.5 1\nvt 0 1\n"
+           "f 1/1 2/2 3/3\n"
+           "f -5/-5 -4/-4 -3/-3 -2/-2\n"
+           "f 1/1 2/2 3/3 4/4 5/5\n";
+}
+
+void writeFile(const std::string &path, const std::string &contents)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open file " + path + "!");
+    }
+    file << contents;
+}
+
+/**
+ * The serial path of loadModel(): tinyobj::LoadObj, then VertexWelder over all
+ * shapes in order.
+ */
+void loadSerial(const std::string &path, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+    {
+        throw std::runtime_error(warn + err);
+    }
+
+    VertexWelder<Vertex> welder(attrib.vertices.size() / 3);
+    for (const auto &shape : shapes)
+    {
+        for (const auto &index : shape.mesh.indices)
+        {
+            Vertex vertex = makeVertex(&attrib.vertices[3 * index.vertex_index], &attrib.texcoords[2 * index.texcoord_index]);
+            indices.push_back(welder.weld(vertex, vertices));
+        }
+    }
+}
+
+/**
+ * Loads 'path' with both loaders at every thread count and compares the output.
+ *
+ * @param name Printed name of the case.
+ * @param expectFallback True if the parallel loader has to refuse the file.
+ */
+void checkFile(const std::string &name, const std::string &path, bool expectFallback)
+{
+    std::vector<Vertex> serialVertices;
+    std::vector<uint32_t> serialIndices;
+    loadSerial(path, serialVertices, serialIndices);
+
+    std::cout << name << ": " << serialVertices.size() << " vertices, " << serialIndices.size() << " indices" << std::endl;
+
+    for (unsigned threadCount : THREAD_COUNTS)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        ObjParallelLoader<Vertex> loader(threadCount);
+        bool loaded = loader.load(path, makeVertex, vertices, indices);
+
+        bool passed;
+        if (expectFallback)
+        {
+            passed = !loaded && vertices.empty() && indices.empty();
+        }
+        else
+        {
+            passed = loaded && indices == serialIndices && vertices.size() == serialVertices.size() &&
+                     std::memcmp(vertices.data(), serialVertices.data(), sizeof(Vertex) * vertices.size()) == 0;
+        }
+
+        check(passed, std::to_string(threadCount) + " threads" + (expectFallback ? ", expected a fallback to tinyobj" : ""));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string directory = argc > 1 ? argv[1] : ".";
+    std::string path = directory + "/obj_parallel_loader_test.obj";
+    try
+    {
+        writeFile(path, makeGridObj(false, false));
+        checkFile("grid", path, false);
+
+        writeFile(path, makeGridObj(false, true));
+        checkFile("grid, CRLF", path, false);
+
+        writeFile(path, makeGridObj(true, false));
+        checkFile("grid with a hexagon in the last range", path, true);
+
+        writeFile(path, makePentagonObj());
+        checkFile("pentagon", path, true);
+    }
+    catch (const std::exception &e)
+    {
+        std::remove(path.c_str());
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::remove(path.c_str());
+    return testResult();
+}
@@ -0,0 +1,77 @@
+/**
+ * Minimal helpers shared by the test executables in tests/.
+ *
+ * A test runs its checks, which report failures and keep going, then returns
+ * testResult() from main():
+ *
+ *      check(indices.size() == expected, "index count");
+ *      ...
+ *      return testResult();
+ */
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*
+ * Checks that failed so far
+ */
+inline int testFailures = 0;
+
+/**
+ * Records a failed check if 'condition' is false.
+ *
+ * @param what Printed with the failure.
+ */
+inline void check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        std::cout << "    FAILED: " << what << std::endl;
+        testFailures++;
+    }
+}
+
+/**
+ * Prints the summary line.
+ *
+ * @return The exit code of the test.
+ */
+inline int testResult()
+{
+    std::cout << (testFailures == 0 ? "all checks passed" : std::to_string(testFailures) + " checks failed") << std::endl;
+    return testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Small deterministic generator (PCG-style LCG), so failures reproduce.
+ */
+class Random
+{
+public:
+    explicit Random(uint64_t seed = 0x853C49E6748FEA9BULL) : state(seed)
+    {
+    }
+
+    uint32_t next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 33);
+    }
+
+    /**
+     * @return A value in [0, bound).
+     */
+    uint32_t below(uint32_t bound)
+    {
+        return next() % bound;
+    }
+
+private:
+    uint64_t state;
+};
+
+#endif // TEST_HARNESS_H
@@ -0,0 +1,351 @@
+/**
+ * Batched, non-blocking upload submission.
+ *
+ * Upload helpers used to record each copy, layout transition or blit into its
+ * own command buffer, submit it and wait for the queue to go idle. The batcher
+ * instead keeps one open command buffer that all upload commands are recorded
+ * into, and submits it once with a fence:
+ *
+ *      stage()     Reserves staging ring space for the next command. Submits the
+ *                  open batch first if the ring cannot hold it otherwise.
+ *      record()    Returns the open command buffer, beginning a new one if needed.
+ *      submit()    Submits the open batch and returns a token for it.
+ *      isComplete()/wait()  Poll or block on a token.
+ *
+ * Each batch ends with a memory barrier that makes its transfer writes visible
+ * to every later command on the queue, so consumers only need queue submission
+ * order, not a host wait. Command buffers of finished batches are freed lazily.
+ *
+ * Uploads on a dedicated transfer queue hand resources to the graphics queue
+ * with a queue family ownership transfer: the release barrier is recorded in
+ * the transfer batch, the matching acquire barrier in a batch on the graphics
+ * queue that waits for a semaphore signaled by the transfer submission (see
+ * recordBufferOwnershipTransfer() and recordImageOwnershipTransfer()).
+ */
+#ifndef UPLOAD_BATCHER_H
+#define UPLOAD_BATCHER_H
+
+#include <vulkan/vulkan.h>
+
+#include "staging_ring.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+
+/*
+ * Identifies a submitted upload batch. 0 refers to no batch and is always complete.
+ */
+typedef uint64_t UploadToken;
+
+/**
+ * Submission counters of an upload batcher.
+ */
+struct UploadBatcherStats
+{
+    uint64_t commandsRecorded = 0; // record() calls
+    uint64_t submissions = 0;
+    double waitMilliseconds = 0.0; // time the host spent blocked in wait()/waitIdle()
+};
+
+class UploadBatcher
+{
+public:
+    /**
+     * @param device Logical device.
+     * @param queue Queue the batches are submitted to.
+     * @param commandPool Pool of 'queue''s family to allocate command buffers from.
+     * @param stagingRing Staging ring the batches read from. It fences and numbers
+     *        the submissions.
+     */
+    UploadBatcher(VkDevice device, VkQueue queue, VkCommandPool commandPool, StagingRing &stagingRing)
+        : device(device), queue(queue), commandPool(commandPool), stagingRing(stagingRing)
+    {
+    }
+
+    /**
+     * Submits anything still recorded, waits for all batches and frees their
+     * command buffers.
+     */
+    ~UploadBatcher()
+    {
+        submit();
+        waitIdle();
+    }
+
+    UploadBatcher(const UploadBatcher &) = delete;
+    UploadBatcher &operator=(const UploadBatcher &) = delete;
+
+    /**
+     * Reserves staging memory for a command that is about to be recorded. Must be
+     * called before record() for that command, since it may submit the open batch.
+     */
+    StagingRegion stage(VkDeviceSize size, VkDeviceSize alignment = 16)
+    {
+        StagingRegion region{};
+        if (!stagingRing.tryAllocate(size, alignment, region))
+        {
+            submit();
+            region = stagingRing.allocate(size, alignment);
+        }
+        staged = true;
+        return region;
+    }
+
+    /**
+     * @return The open command buffer to record upload commands into.
+     */
+    VkCommandBuffer record()
+    {
+        if (current == VK_NULL_HANDLE)
+        {
+            recycle();
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &current) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            if (vkBeginCommandBuffer(current, &beginInfo) != VK_SUCCESS)
+            {
+                discard();
+                throw std::runtime_error("failed to begin upload command buffer!");
+            }
+        }
+
+        stats.commandsRecorded++;
+        return current;
+    }
+
+    /**
+     * Tells whether commands have been recorded since the last submit().
+     */
+    bool empty() const
+    {
+        return current == VK_NULL_HANDLE;
+    }
+
+    /**
+     * Submits the open batch without waiting for it.
+     *
+     * @param signalSemaphore Semaphore to signal when the batch and everything
+     *        submitted to the queue before it has executed, or VK_NULL_HANDLE.
+     * @param waitSemaphore Semaphore the batch waits for, or VK_NULL_HANDLE.
+     * @param waitStage Stages of the batch that wait for 'waitSemaphore'.
+     * @return Token of the batch, or of the previous batch if nothing was recorded
+     *         and no semaphore was given.
+     */
+    UploadToken submit(VkSemaphore signalSemaphore = VK_NULL_HANDLE, VkSemaphore waitSemaphore = VK_NULL_HANDLE,
+                       VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)
+    {
+        if (current == VK_NULL_HANDLE && signalSemaphore == VK_NULL_HANDLE && waitSemaphore == VK_NULL_HANDLE)
+        {
+            return lastToken;
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        if (current != VK_NULL_HANDLE)
+        {
+            /*
+             * Make the batch's transfer writes available and visible to everything
+             * that runs after it on this queue
+             */
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+            vkCmdPipelineBarrier(current, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            if (vkEndCommandBuffer(current) != VK_SUCCESS)
+            {
+                discard();
+                throw std::runtime_error("failed to end upload command buffer!");
+            }
+
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &current;
+        }
+
+        if (signalSemaphore != VK_NULL_HANDLE)
+        {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &signalSemaphore;
+        }
+        if (waitSemaphore != VK_NULL_HANDLE)
+        {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &waitSemaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
+
+        /* Only a submission the queue accepted may be fenced in the ring */
+        if (vkQueueSubmit(queue, 1, &submitInfo, stagingRing.nextFence()) != VK_SUCCESS)
+        {
+            discard();
+            throw std::runtime_error("failed to submit upload batch!");
+        }
+
+        stagingRing.commit(staged);
+        lastToken = stagingRing.lastSerial();
+        if (current != VK_NULL_HANDLE)
+        {
+            inFlight.push_back(Batch{lastToken, current});
+        }
+        current = VK_NULL_HANDLE;
+        staged = false;
+        stats.submissions++;
+        return lastToken;
+    }
+
+    /**
+     * Tells whether the batch identified by 'token' has finished executing.
+     */
+    bool isComplete(UploadToken token)
+    {
+        return stagingRing.isComplete(token);
+    }
+
+    /**
+     * Blocks until the batch identified by 'token' has finished executing.
+     */
+    void wait(UploadToken token)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        stagingRing.wait(token);
+        stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        recycle();
+    }
+
+    /**
+     * Blocks until every submitted batch has finished executing.
+     */
+    void waitIdle()
+    {
+        wait(lastToken);
+    }
+
+    const UploadBatcherStats &statistics() const
+    {
+        return stats;
+    }
+
+private:
+    struct Batch
+    {
+        UploadToken token;
+        VkCommandBuffer commandBuffer;
+    };
+
+    /*
+     * Frees the command buffers of finished batches.
+     */
+    void recycle()
+    {
+        while (!inFlight.empty() && stagingRing.isComplete(inFlight.front().token))
+        {
+            vkFreeCommandBuffers(device, commandPool, 1, &inFlight.front().commandBuffer);
+            inFlight.pop_front();
+        }
+    }
+
+    /*
+     * Drops the open batch after a failure. Its staging regions stay pending and
+     * are released with the next submission.
+     */
+    void discard()
+    {
+        if (current != VK_NULL_HANDLE)
+        {
+            vkFreeCommandBuffers(device, commandPool, 1, &current);
+            current = VK_NULL_HANDLE;
+        }
+    }
+
+    VkDevice device;
+    VkQueue queue;
+    VkCommandPool commandPool;
+    StagingRing &stagingRing;
+
+    VkCommandBuffer current = VK_NULL_HANDLE;
+    bool staged = false; // Staging regions were allocated for the open batch
+    UploadToken lastToken = 0;
+    std::deque<Batch> inFlight;
+    UploadBatcherStats stats;
+};
+
+/**
+ * Records one half of a queue family ownership transfer of a whole buffer
+ * written by transfer commands. The release half is recorded on the source
+ * queue, the acquire half with the same family indices on the destination queue.
+ *
+ * @param commandBuffer Command buffer of the source (release) or destination
+ *        (acquire) queue.
+ * @param buffer The buffer changing ownership.
+ * @param srcQueueFamily Family that wrote the buffer.
+ * @param dstQueueFamily Family that uses the buffer from now on.
+ * @param release True for the release half, false for the acquire half.
+ */
+inline void recordBufferOwnershipTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamily, uint32_t dstQueueFamily, bool release)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+    barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+/**
+ * Image counterpart of recordBufferOwnershipTransfer(). The image keeps its
+ * layout across the transfer.
+ *
+ * @param layout Current layout of all mip levels of the image.
+ * @param mipLevels Number of mip levels of the image.
+ */
+inline void recordImageOwnershipTransfer(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, uint32_t mipLevels,
+                                         uint32_t srcQueueFamily, uint32_t dstQueueFamily, bool release)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+    barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.oldLayout = layout;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+#endif // UPLOAD_BATCHER_H
@@ -0,0 +1,178 @@
+/**
+ * Flat open-addressing hash table for vertex deduplication ("welding").
+ *
+ * std::unordered_map allocates a node per unique vertex and, used as
+ * count() followed by two operator[] lookups, hashes every corner three times.
+ * The welder instead keeps a single power-of-two array of 8-byte slots
+ * (32-bit hash + index into the output vertex array), hashes the raw bit
+ * pattern of the vertex once, and finds or inserts it in one linear probe.
+ *
+ * Vertices are compared bit for bit, so the vertex type must be trivially
+ * copyable and free of padding. Note that this treats 0.0f and -0.0f as
+ * different values, unlike comparing with operator==.
+ */
+#ifndef VERTEX_WELDER_H
+#define VERTEX_WELDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+template <typename VertexT>
+class VertexWelder
+{
+    static_assert(std::is_trivially_copyable<VertexT>::value, "welded vertex type must be trivially copyable");
+
+public:
+    /**
+     * @param expectedVertices Number of unique vertices expected. The table is
+     *        sized so it does not need to grow until this many are inserted.
+     */
+    explicit VertexWelder(size_t expectedVertices = 0)
+    {
+        reserve(expectedVertices);
+    }
+
+    /**
+     * Grows the table so that at least 'expectedVertices' unique vertices fit
+     * without rehashing.
+     */
+    void reserve(size_t expectedVertices)
+    {
+        size_t capacity = 16;
+        while (capacity < expectedVertices * 2)
+        {
+            capacity *= 2;
+        }
+        if (capacity > slots.size())
+        {
+            rehash(capacity);
+        }
+    }
+
+    /**
+     * Returns the index of 'vertex' in 'vertices', appending it first if it
+     * has not been seen before.
+     *
+     * @param vertex The vertex to look up.
+     * @param vertices Output array of unique vertices. Must only be appended to
+     *        through this welder.
+     * @return Index of the vertex in 'vertices'.
+     */
+    uint32_t weld(const VertexT &vertex, std::vector<VertexT> &vertices)
+    {
+        if ((count + 1) * 2 > slots.size())
+        {
+            rehash(slots.size() * 2);
+        }
+
+        uint32_t hash = hashVertex(vertex);
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+
+        while (true)
+        {
+            Slot &slot = slots[i];
+            if (slot.index == EMPTY)
+            {
+                if (vertices.size() >= EMPTY)
+                {
+                    throw std::runtime_error("too many unique vertices for 32-bit indices!");
+                }
+                slot.hash = hash;
+                slot.index = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+                count++;
+                return slot.index;
+            }
+            if (slot.hash == hash && std::memcmp(&vertices[slot.index], &vertex, sizeof(VertexT)) == 0)
+            {
+                return slot.index;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    /**
+     * Number of unique vertices inserted so far.
+     */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * Hash of the raw bytes of a vertex: 64-bit word-wise multiply/rotate mixing
+     * followed by the MurmurHash3 finalizer, folded to 32 bits.
+     */
+    static uint32_t hashVertex(const VertexT &vertex)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&vertex);
+        uint64_t h = 0x9E3779B97F4A7C15ULL ^ sizeof(VertexT);
+
+        size_t offset = 0;
+        for (; offset + 8 <= sizeof(VertexT); offset += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + offset, 8);
+            h ^= word * 0xBF58476D1CE4E5B9ULL;
+            h = ((h << 31) | (h >> 33)) * 0x94D049BB133111EBULL;
+        }
+        if (offset < sizeof(VertexT))
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + offset, sizeof(VertexT) - offset);
+            h ^= word * 0xBF58476D1CE4E5B9ULL;
+            h = ((h << 31) | (h >> 33)) * 0x94D049BB133111EBULL;
+        }
+
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return static_cast<uint32_t>(h);
+    }
+
+private:
+    static const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    /*
+     * Rebuilds the table with 'capacity' slots. The stored hashes are reused, so
+     * no vertex data is touched.
+     */
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> oldSlots(capacity, Slot{0, EMPTY});
+        oldSlots.swap(slots);
+
+        size_t mask = capacity - 1;
+        for (const Slot &slot : oldSlots)
+        {
+            if (slot.index == EMPTY)
+            {
+                continue;
+            }
+            size_t i = slot.hash & mask;
+            while (slots[i].index != EMPTY)
+            {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+#endif // VERTEX_WELDER_H